@@ -0,0 +1,49 @@
+#include "allocationCounter.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+#ifndef NDEBUG
+
+namespace {
+
+std::atomic<long> totalAllocations(0);
+thread_local long threadAllocations = 0; // plain zero-initialized, so using it never allocates
+
+void *countedAllocation(std::size_t size){
+    threadAllocations++;
+    totalAllocations.fetch_add(1, std::memory_order_relaxed);
+    void *p = std::malloc(size ? size : 1);
+    if (!p){throw std::bad_alloc();}
+    return p;
+}
+
+void *countedAllocation(std::size_t size, const std::nothrow_t &){
+    threadAllocations++;
+    totalAllocations.fetch_add(1, std::memory_order_relaxed);
+    return std::malloc(size ? size : 1);
+}
+
+} // namespace
+
+void *operator new(std::size_t size){return countedAllocation(size);}
+void *operator new[](std::size_t size){return countedAllocation(size);}
+void *operator new(std::size_t size, const std::nothrow_t &tag) noexcept {return countedAllocation(size, tag);}
+void *operator new[](std::size_t size, const std::nothrow_t &tag) noexcept {return countedAllocation(size, tag);}
+void operator delete(void *p) noexcept {std::free(p);}
+void operator delete[](void *p) noexcept {std::free(p);}
+void operator delete(void *p, const std::nothrow_t &) noexcept {std::free(p);}
+void operator delete[](void *p, const std::nothrow_t &) noexcept {std::free(p);}
+
+bool allocationCountingEnabled(){return true;}
+long threadAllocationCount(){return threadAllocations;}
+long totalAllocationCount(){return totalAllocations.load(std::memory_order_relaxed);}
+
+#else
+
+bool allocationCountingEnabled(){return false;}
+long threadAllocationCount(){return 0;}
+long totalAllocationCount(){return 0;}
+
+#endif
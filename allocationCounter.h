@@ -0,0 +1,22 @@
+/***************************************
+ Heap allocation counter for debug builds.
+
+ Unless NDEBUG is defined, the global operator new / delete are replaced by
+ versions that count every allocation, per thread and in total, so a loop
+ can show it runs without touching the heap once it is warmed up. cv::Mat
+ buffers come from OpenCV's own allocator and are not seen here; callers
+ check those by watching the Mat data pointers. In release builds nothing
+ is replaced and the counts stay 0.
+ ************************************/
+
+#ifndef ALLOCATION_COUNTER_H
+#define ALLOCATION_COUNTER_H
+
+/// True when allocations are being counted (debug builds).
+bool allocationCountingEnabled();
+/// Heap allocations made so far by the calling thread.
+long threadAllocationCount();
+/// Heap allocations made so far by all threads.
+long totalAllocationCount();
+
+#endif
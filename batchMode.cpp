@@ -0,0 +1,243 @@
+#include "batchMode.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <fstream>
+#include <iostream>
+#include <thread>
+#include "openCVCompat.h"
+#include "objectTracking.h"
+#include "pyramidDetector.h"
+#include "raceTiming.h"
+#include "roiTracker.h"
+#include "tileChangeDetector.h"
+
+namespace {
+
+/// Frames [firstFrame, endFrame) of one video, handled by one worker thread.
+struct Segment {
+    int firstFrame;
+    int endFrame; // -1 = until the video ends
+    std::vector<BatchRecord> records;
+    long frames; // decoded, records holds one per target and frame
+    TileStats tiles;
+    bool opened;
+};
+
+/// Make frame firstFrame the next one read. Seeking in a video with inter-frame compression lands on a keyframe
+/// near the frame on many backends, so the position is read back and the frames up to firstFrame are decoded and
+/// discarded. When the backend cannot seek, or lands past the frame, the video is decoded from the start.
+/// False if the video ends first.
+bool seekToFrame(cv::VideoCapture &capture, const std::string &file, int firstFrame){
+    if (firstFrame <= 0){return true;}
+    int position = -1;
+    if (capture.set(CV_CAP_PROP_POS_FRAMES, firstFrame)){
+        position = (int)capture.get(CV_CAP_PROP_POS_FRAMES);
+    }
+    //0 is also what backends without a frame position report
+    if (position <= 0 || position > firstFrame){
+        capture.release();
+        if (!capture.open(file)){return false;}
+        position = 0;
+    }
+    for (; position < firstFrame; position++){
+        if (!capture.grab()){return false;}
+    }
+    return true;
+}
+
+void processSegment(const std::string &file, int videoIndex, double fps, const BatchOptions &options,
+                    const ColorClassifier *classifier, Segment &segment){
+    cv::VideoCapture capture(file);
+    segment.opened = capture.isOpened();
+    if (!segment.opened){return;}
+    //segments must not overlap or leave gaps, and the records carry the frame numbers
+    if (!seekToFrame(capture, file, segment.firstFrame)){return;}
+
+    cv::Mat frame, threshold;
+    std::vector<cv::Mat> masks;
+    std::vector<Detection> detections(1);
+    RoiTracker roiTracker;
+    roiTracker.setDecimation(options.decimation);
+    PyramidDetector pyramid(options.decimation);
+    TileChangeDetector tileDetector;
+    int frameIndex = segment.firstFrame;
+    if (segment.endFrame > 0){
+        segment.records.reserve((size_t)(segment.endFrame - segment.firstFrame)*std::max<size_t>(1, options.targets.size()));
+    }
+    while (segment.endFrame < 0 || frameIndex < segment.endFrame){
+        double positionMs = capture.get(CV_CAP_PROP_POS_MSEC);
+        if (!capture.read(frame) || frame.empty()){break;}
+
+        if (classifier){
+            detectTargets(*classifier, frame, options.useMorphOps, masks, detections);
+        }else if (options.roiTracking){
+            detections[0] = roiTracker.detect(frame, options.range, options.useMorphOps, frameIndex);
+        }else if (options.decimation > 1){
+            detections[0] = pyramid.detect(frame, options.range, options.useMorphOps);
+        }else if (options.tileSkipping){
+            tileDetector.threshold(frame, options.range, options.useMorphOps, threshold);
+            detections[0] = findFilteredObject(threshold);
+        }else{
+            hsvThreshold(frame, options.range, threshold);
+            if (options.useMorphOps){morphOps(threshold);}
+            detections[0] = findFilteredObject(threshold);
+        }
+
+        for (size_t t = 0; t < detections.size(); t++){
+            const Detection &detection = detections[t];
+            BatchRecord record;
+            record.videoIndex = videoIndex;
+            record.frameIndex = frameIndex;
+            record.target = (int)t;
+            // frame index over frame rate does not drift after a seek, fall back to the decoder position otherwise
+            record.timestampMs = fps > 0 ? frameIndex*1000.0/fps : positionMs;
+            record.found = detection.found;
+            record.x = detection.x;
+            record.y = detection.y;
+            record.area = detection.area;
+            record.yaw = detection.found ? detection.yaw : 0;
+            record.pitch = detection.found ? detection.pitch : 0;
+            segment.records.push_back(record);
+        }
+        frameIndex++;
+        segment.frames++;
+    }
+    segment.tiles = tileDetector.total();
+}
+
+template <typename T>
+void writeField(std::ofstream &out, T value){
+    out.write(reinterpret_cast<const char*>(&value), sizeof(value));
+}
+
+bool endsWith(const std::string &s, const std::string &suffix){
+    return s.size() >= suffix.size() && s.compare(s.size() - suffix.size(), suffix.size(), suffix) == 0;
+}
+
+} // namespace
+
+int runBatch(const BatchOptions &options){
+    bool binary = endsWith(options.output, ".bin");
+    std::ofstream out(options.output.c_str(), binary ? std::ios::binary : std::ios::out);
+    if (!out){
+        std::cerr << "Cannot write " << options.output << std::endl;
+        return 1;
+    }
+    if (binary){
+        out.write("QRDLOG02", 8);
+    }else{
+        out << "video,frame,target,timestamp_ms,found,x,y,area,yaw,pitch\n";
+    }
+
+    // every worker reads the same table, it is built once up front unless a profile brought it along
+    ColorClassifier classifier;
+    if (!options.classifier){
+        for (size_t t = 0; t < options.targets.size(); t++){
+            if (classifier.addTarget(options.targets[t].name, options.targets[t].range) < 0){
+                std::cerr << "At most " << MAX_TARGETS << " targets are supported" << std::endl;
+                return 1;
+            }
+        }
+    }
+    const ColorClassifier *targetClassifier = options.targets.empty() ? 0 : options.classifier ? options.classifier.get() : &classifier;
+
+    int threads = options.threads > 0 ? options.threads : std::max(1, (int)std::thread::hardware_concurrency());
+    long totalFrames = 0;
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+
+    for (size_t v = 0; v < options.inputs.size(); v++){
+        const std::string &file = options.inputs[v];
+        cv::VideoCapture probe(file);
+        if (!probe.isOpened()){
+            std::cerr << "Cannot open " << file << std::endl;
+            return 1;
+        }
+        int frameCount = (int)probe.get(CV_CAP_PROP_FRAME_COUNT);
+        double fps = probe.get(CV_CAP_PROP_FPS);
+        probe.release();
+
+        // split the video into one contiguous segment per thread. without a frame count, decode it in one piece.
+        int numSegments = frameCount > 0 ? std::min(threads, frameCount) : 1;
+        std::vector<Segment> segments(numSegments);
+        for (int i = 0; i < numSegments; i++){
+            segments[i].firstFrame = frameCount > 0 ? (int)((long)frameCount*i/numSegments) : 0;
+            segments[i].endFrame = frameCount > 0 ? (int)((long)frameCount*(i + 1)/numSegments) : -1;
+            segments[i].opened = false;
+            segments[i].frames = 0;
+        }
+        // the last segment reads to the end, in case the container's frame count is short
+        segments[numSegments - 1].endFrame = -1;
+
+        std::vector<std::thread> workers;
+        for (int i = 0; i < numSegments; i++){
+            workers.push_back(std::thread(processSegment, std::cref(file), (int)v, fps, std::cref(options),
+                                         targetClassifier, std::ref(segments[i])));
+        }
+        for (size_t i = 0; i < workers.size(); i++){workers[i].join();}
+
+        for (int i = 0; i < numSegments; i++){
+            if (!segments[i].opened){
+                std::cerr << "Cannot open " << file << std::endl;
+                return 1;
+            }
+            const std::vector<BatchRecord> &records = segments[i].records;
+            for (size_t r = 0; r < records.size(); r++){
+                const BatchRecord &rec = records[r];
+                if (binary){
+                    writeField(out, rec.videoIndex);
+                    writeField(out, rec.frameIndex);
+                    writeField(out, (unsigned char)rec.target);
+                    writeField(out, rec.timestampMs);
+                    writeField(out, rec.found);
+                    writeField(out, rec.x);
+                    writeField(out, rec.y);
+                    writeField(out, rec.area);
+                    writeField(out, (signed char)rec.yaw);
+                    writeField(out, (signed char)rec.pitch);
+                }else{
+                    char line[160];
+                    snprintf(line, sizeof(line), "%d,%d,%d,%.3f,%d,%d,%d,%.1f,%d,%d\n", rec.videoIndex, rec.frameIndex, rec.target,
+                             rec.timestampMs, rec.found, rec.x, rec.y, rec.area, rec.yaw, rec.pitch);
+                    out << line;
+                }
+            }
+            totalFrames += segments[i].frames;
+        }
+        std::cout << file << ": " << frameCount << " frames in " << numSegments << " segments" << std::endl;
+        if (options.tileSkipping && !targetClassifier && !options.roiTracking && options.decimation <= 1){
+            TileStats tiles;
+            for (int i = 0; i < numSegments; i++){
+                tiles.tiles += segments[i].tiles.tiles;
+                tiles.thresholded += segments[i].tiles.thresholded;
+            }
+            std::cout << "  tiles skipped " << (int)(100*tiles.skippedFraction() + 0.5) << "%" << std::endl;
+        }
+
+        // with gate targets, re-score the race: target 0 is the start/finish line, the others are checkpoints
+        if (targetClassifier){
+            RaceTiming timing((int)options.targets.size());
+            for (int i = 0; i < numSegments; i++){
+                const std::vector<BatchRecord> &records = segments[i].records;
+                for (size_t r = 0; r < records.size(); r++){
+                    timing.observe(0, records[r].target, records[r].found != 0, records[r].timestampMs/1000.0);
+                }
+            }
+            std::vector<LapRecord> laps = timing.laps(0);
+            for (size_t l = 0; l < laps.size(); l++){
+                std::cout << "  lap " << laps[l].lap << ": " << formatLapTime(laps[l].lapTime);
+                for (size_t c = 0; c < laps[l].splits.size(); c++){
+                    std::cout << "  " << options.targets[c + 1].name << " "
+                              << (laps[l].splits[c] >= 0 ? formatLapTime(laps[l].splits[c]) : "-");
+                }
+                std::cout << std::endl;
+            }
+        }
+    }
+
+    double seconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    std::cout << totalFrames << " frames in " << seconds << " s (" << (seconds > 0 ? totalFrames/seconds : 0)
+              << " fps), log written to " << options.output << std::endl;
+    return 0;
+}
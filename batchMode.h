@@ -0,0 +1,63 @@
+/***************************************
+ Headless batch mode for recorded race footage.
+
+ Each input video is split into segments that are decoded and processed on
+ separate worker threads, as fast as the CPU allows and without any window.
+ Every worker starts exactly on its segment's first frame, decoding forward
+ from wherever the backend's seek landed, so segments neither overlap nor
+ leave gaps.
+ One row per frame (frame index, timestamp, centroid, area, yaw, pitch) is
+ written to a CSV file, or to a compact binary log when the output name ends
+ in ".bin". With several targets (gates) every frame gets one row per target,
+ all classified in a single lookup table pass, and the lap and split times of
+ each video are printed (the first target is the start/finish line).
+ The single range can be searched coarse-to-fine (BatchOptions::decimation),
+ or, for footage from a fixed camera, only where the frame changed
+ (BatchOptions::tileSkipping).
+
+ Binary log layout (little-endian): the 8 byte magic "QRDLOG02", then one
+ BatchRecord per frame and target, in video, frame and target order.
+ ************************************/
+
+#ifndef BATCH_MODE_H
+#define BATCH_MODE_H
+
+#include <memory>
+#include <string>
+#include <vector>
+#include "colorClassifier.h"
+#include "hsvThreshold.h"
+
+struct BatchOptions {
+    std::vector<std::string> inputs; // video files, processed one after the other
+    HSVRange range;                  // fixed threshold bounds for every frame
+    std::vector<ColorTarget> targets; // several targets instead of range, classified through one table
+    std::shared_ptr<const ColorClassifier> classifier; // table already built for targets (calibration profile), 0 = build it
+    std::string output;              // log file name, "detections.csv" by default
+    int threads;                     // worker threads per video, 0 = one per core
+    bool useMorphOps;
+    bool roiTracking;                // predictive window search within each segment
+    int decimation;                  // coarse-to-fine search on a frame this many times smaller, 1 = full resolution
+    bool tileSkipping;               // threshold only the tiles that changed, see tileChangeDetector.h
+    BatchOptions(): output("detections.csv"), threads(0), useMorphOps(true), roiTracking(false), decimation(1), tileSkipping(false) {
+        HSVRange all = {0, 256, 0, 256, 0, 256};
+        range = all;
+    }
+};
+
+/// One detection log entry. Written field by field, so the on-disk size is 39 bytes.
+struct BatchRecord {
+    int videoIndex;      // position of the video in BatchOptions::inputs
+    int frameIndex;
+    int target;          // position of the target in BatchOptions::targets, 0 for the single range
+    double timestampMs;  // position of the frame in its video
+    int found;
+    int x, y;
+    double area;
+    int yaw, pitch;
+};
+
+/// Process every input video and write the detection log. Returns 0 on success.
+int runBatch(const BatchOptions &options);
+
+#endif
@@ -0,0 +1,385 @@
+/***************************************
+ Per-stage benchmark of the tracking loop on synthetic frames.
+
+ Every stage of the per-frame work (color conversion, threshold, morphology,
+ blob search, overlay, histogram counting and drawing, multi-target
+ classification and the whole frame, with and without the latency marks)
+ is timed on its own over the same deterministic input, and the optimized
+ stages are checked against the OpenCV calls they replace. Coarse-to-fine
+ detection is also compared with the full resolution result for accuracy
+ and throughput, and tile skipping with the full-frame mask on a sequence
+ with a static background.
+
+ Usage:
+   quadRacingBenchmark [--frames N] [--size WxH] [--seed N] [--csv results.csv]
+                       [--baseline results.csv] [--tolerance 0.15]
+
+ With --baseline, any stage whose median is more than tolerance slower than
+ the median recorded in the baseline CSV is reported and the exit code is 2,
+ so a build script can fail on performance regressions.
+ ************************************/
+
+#include <algorithm>
+#include <cmath>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <iostream>
+#include <map>
+#include <sstream>
+#include <string>
+#include <vector>
+#include <opencv2/opencv.hpp>
+#include "allocationCounter.h"
+#include "colorClassifier.h"
+#include "histogram.h"
+#include "hsvThreshold.h"
+#include "latencyStats.h"
+#include "objectTracking.h"
+#include "pyramidDetector.h"
+#include "roiTracker.h"
+#include "syntheticFrames.h"
+#include "tileChangeDetector.h"
+
+namespace {
+
+/// Distinct frames kept in memory and cycled through, so frame generation is never timed.
+const int FRAME_POOL_SIZE = 32;
+/// Untimed passes over each stage before measuring.
+const int WARMUP_FRAMES = 10;
+/// A detection within this many pixels of the true blob center counts as a hit.
+const int HIT_RADIUS = 6;
+/// Decimation factors compared against full resolution. The first one must be 1.
+const int DECIMATIONS[] = {1, 2, 4};
+const int NUM_DECIMATIONS = sizeof(DECIMATIONS)/sizeof(DECIMATIONS[0]);
+
+struct StageResult {
+    std::string name;
+    double mean, p50, p99, max;
+    double allocations; // heap allocations per timed frame, debug builds only
+};
+
+class Stopwatch {
+public:
+    void start(){begin = cv::getTickCount();}
+    double stopMs() const {return (cv::getTickCount() - begin)*1000.0/cv::getTickFrequency();}
+private:
+    int64 begin;
+};
+
+StageResult summarize(const std::string &name, std::vector<double> samples, long allocations){
+    StageResult result;
+    result.name = name;
+    result.mean = result.p50 = result.p99 = result.max = 0;
+    result.allocations = samples.empty() ? 0 : (double)allocations/samples.size();
+    if (samples.empty()){return result;}
+    std::sort(samples.begin(), samples.end());
+    double sum = 0;
+    for (size_t i = 0; i < samples.size(); i++){sum += samples[i];}
+    result.mean = sum/samples.size();
+    result.p50 = samples[samples.size()/2];
+    result.p99 = samples[std::min(samples.size() - 1, samples.size()*99/100)];
+    result.max = samples.back();
+    return result;
+}
+
+/// The pre-bit-packing morphOps(): erode twice 3x3, dilate four times 8x8.
+void openCVMorphOps(cv::Mat &thresh){
+    static const cv::Mat erodeElement = cv::getStructuringElement(cv::MORPH_RECT,cv::Size(3,3));
+    static const cv::Mat dilateElement = cv::getStructuringElement(cv::MORPH_RECT,cv::Size(8,8));
+    erode(thresh,thresh,erodeElement);
+    erode(thresh,thresh,erodeElement);
+    dilate(thresh,thresh,dilateElement);
+    dilate(thresh,thresh,dilateElement);
+    dilate(thresh,thresh,dilateElement);
+    dilate(thresh,thresh,dilateElement);
+}
+
+bool sameMask(const cv::Mat &a, const cv::Mat &b){
+    return a.size() == b.size() && a.type() == b.type() && cv::countNonZero(a != b) == 0;
+}
+
+bool isHit(const Detection &detection, cv::Point truth){
+    int dx = detection.x - truth.x, dy = detection.y - truth.y;
+    return detection.found && dx*dx + dy*dy <= HIT_RADIUS*HIT_RADIUS;
+}
+
+std::map<std::string, StageResult> readBaseline(const std::string &file){
+    std::map<std::string, StageResult> baseline;
+    std::ifstream in(file.c_str());
+    std::string line;
+    std::getline(in, line); // header
+    while (std::getline(in, line)){
+        std::stringstream ss(line);
+        StageResult r;
+        std::string field;
+        if (!std::getline(ss, r.name, ',')){continue;}
+        double values[4];
+        int n = 0;
+        while (n < 4 && std::getline(ss, field, ',')){values[n++] = atof(field.c_str());}
+        if (n < 4){continue;}
+        r.mean = values[0]; r.p50 = values[1]; r.p99 = values[2]; r.max = values[3];
+        baseline[r.name] = r;
+    }
+    return baseline;
+}
+
+} // namespace
+
+int main(int argc, char* argv[]){
+    int numFrames = 300;
+    cv::Size size(FRAME_WIDTH, FRAME_HEIGHT);
+    unsigned seed = 1;
+    std::string csvFile, baselineFile;
+    double tolerance = 0.15;
+    for (int i = 1; i < argc; i++){
+        std::string arg = argv[i];
+        if (arg == "--frames" && i + 1 < argc){
+            numFrames = std::max(1, atoi(argv[++i]));
+        }else if (arg == "--size" && i + 1 < argc){
+            if (sscanf(argv[++i], "%dx%d", &size.width, &size.height) != 2 || size.width < 16 || size.height < 16){
+                std::cerr << "--size expects WxH" << std::endl;
+                return 1;
+            }
+        }else if (arg == "--seed" && i + 1 < argc){
+            seed = (unsigned)strtoul(argv[++i], 0, 10);
+        }else if (arg == "--csv" && i + 1 < argc){
+            csvFile = argv[++i];
+        }else if (arg == "--baseline" && i + 1 < argc){
+            baselineFile = argv[++i];
+        }else if (arg == "--tolerance" && i + 1 < argc){
+            tolerance = atof(argv[++i]);
+        }else{
+            std::cerr << "Unknown option " << arg << std::endl;
+            return 1;
+        }
+    }
+
+    //the histogram must not move the thresholds while it is being timed
+    lockHSVThreshold = true;
+
+    SyntheticFrames generator(size, seed);
+    const HSVRange range = generator.blob(0).range;
+    H_MIN = range.hMin; H_MAX = range.hMax;
+    S_MIN = range.sMin; S_MAX = range.sMax;
+    V_MIN = range.vMin; V_MAX = range.vMax;
+
+    std::vector<cv::Mat> frames(FRAME_POOL_SIZE);
+    for (int i = 0; i < FRAME_POOL_SIZE; i++){generator.render(i, frames[i]);}
+
+    ColorClassifier classifier;
+    for (int t = 0; t < generator.numBlobs(); t++){classifier.addTarget(generator.blob(t).name, generator.blob(t).range);}
+
+    std::cout << "Frame " << size.width << "x" << size.height << ", " << numFrames << " frames, hsvThreshold path: "
+              << hsvThresholdPath() << ", OpenCV " << CV_VERSION << ", " << cv::getNumThreads() << " OpenCV threads" << std::endl;
+
+    //correctness first: the fused and bit-packed stages must match the OpenCV calls they replace
+    bool correct = true;
+    for (int i = 0; i < FRAME_POOL_SIZE; i++){
+        cv::Mat hsv, reference, fused;
+        cv::cvtColor(frames[i], hsv, cv::COLOR_BGR2HSV);
+        cv::inRange(hsv, cv::Scalar(range.hMin,range.sMin,range.vMin), cv::Scalar(range.hMax,range.sMax,range.vMax), reference);
+        hsvThreshold(frames[i], range, fused);
+        if (!sameMask(reference, fused)){
+            std::cerr << "hsvThreshold differs from cvtColor + inRange on frame " << i << std::endl;
+            correct = false;
+        }
+        openCVMorphOps(reference);
+        morphOps(fused);
+        if (!sameMask(reference, fused)){
+            std::cerr << "morphOps differs from cv::erode/cv::dilate on frame " << i << std::endl;
+            correct = false;
+        }
+    }
+
+    std::vector<StageResult> results;
+    Stopwatch watch;
+    cv::Mat hsv, threshold, feed, histImage;
+    ChannelHistogram histogram;
+    std::vector<cv::Mat> masks;
+    std::vector<Detection> detections;
+    int x = 0, y = 0;
+    int hits = 0, roiHits = 0, targetHits = 0, targetSamples = 0;
+    int tileMaskMismatches = 0;
+    double tilesSkipped = 0;
+    StageResult pyramidResults[NUM_DECIMATIONS];
+
+    //each stage times only its own call. its inputs are prepared outside the timed region.
+    #define TIME_STAGE(NAME, PREPARE, BODY) { \
+        std::vector<double> samples; \
+        samples.reserve(numFrames); \
+        long allocations = 0; \
+        for (int n = -WARMUP_FRAMES; n < numFrames; n++){ \
+            int f = (n + WARMUP_FRAMES) % FRAME_POOL_SIZE; \
+            const cv::Mat &frame = frames[f]; \
+            (void)frame; \
+            PREPARE; \
+            long before = threadAllocationCount(); \
+            watch.start(); \
+            BODY; \
+            double ms = watch.stopMs(); \
+            if (n >= 0){ \
+                samples.push_back(ms); \
+                allocations += threadAllocationCount() - before; \
+            } \
+        } \
+        results.push_back(summarize(NAME, samples, allocations)); \
+    }
+
+    TIME_STAGE("cvtColor BGR2HSV", (void)0, cv::cvtColor(frame, hsv, cv::COLOR_BGR2HSV));
+    TIME_STAGE("inRange", cv::cvtColor(frame, hsv, cv::COLOR_BGR2HSV),
+               cv::inRange(hsv, cv::Scalar(range.hMin,range.sMin,range.vMin), cv::Scalar(range.hMax,range.sMax,range.vMax), threshold));
+    TIME_STAGE("hsvThreshold (fused)", (void)0, hsvThreshold(frame, range, threshold));
+    TIME_STAGE("erode/dilate (OpenCV)", hsvThreshold(frame, range, threshold), openCVMorphOps(threshold));
+    TIME_STAGE("morphOps (bit-packed)", hsvThreshold(frame, range, threshold), morphOps(threshold));
+    TIME_STAGE("findFilteredObject", hsvThreshold(frame, range, threshold); morphOps(threshold),
+               Detection d = findFilteredObject(threshold); (void)d);
+    TIME_STAGE("trackFilteredObject", hsvThreshold(frame, range, threshold); morphOps(threshold); frame.copyTo(feed),
+               trackFilteredObject(x, y, threshold, feed));
+    TIME_STAGE("computeHistogram", cv::cvtColor(frame, hsv, cv::COLOR_BGR2HSV), computeHistogram(hsv, histogram));
+    TIME_STAGE("computeHistogram (step 2)", cv::cvtColor(frame, hsv, cv::COLOR_BGR2HSV), computeHistogram(hsv, histogram, 2));
+    TIME_STAGE("renderHistogram", cv::cvtColor(frame, hsv, cv::COLOR_BGR2HSV); computeHistogram(hsv, histogram),
+               renderHistogram(histogram, true, histImage));
+    TIME_STAGE("detectTargets (3 gates)", (void)0, detectTargets(classifier, frame, true, masks, detections));
+    TIME_STAGE("end-to-end", frame.copyTo(feed),
+               hsvThreshold(feed, range, threshold); morphOps(threshold); trackFilteredObject(x, y, threshold, feed));
+    //the same frame with the pipeline's latency marks, to keep an eye on what the instrumentation costs
+    setLatencyInstrumentation(true);
+    TIME_STAGE("end-to-end (latency marks)", frame.copyTo(feed),
+               latencyFrameBegin(); hsvThreshold(feed, range, threshold); latencyMark(STAGE_THRESHOLD);
+               morphOps(threshold); latencyMark(STAGE_MORPH); Detection d = findFilteredObject(threshold); latencyMark(STAGE_BLOB);
+               reportDetection(d, x, y, feed); latencyRecord(STAGE_DECISION, 0); latencyMark(STAGE_OVERLAY); latencyFrameEnd());
+    setLatencyInstrumentation(false);
+    for (int i = 0; i < NUM_DECIMATIONS; i++){
+        PyramidDetector pyramid(DECIMATIONS[i]);
+        TIME_STAGE("PyramidDetector " + intToString(DECIMATIONS[i]) + "x", (void)0,
+                   Detection d = pyramid.detect(frame, range, true); (void)d);
+        pyramidResults[i] = results.back();
+    }
+    #undef TIME_STAGE
+
+    //predictive tracking depends on the frame order, so it runs over a rendered sequence instead of the pool
+    {
+        RoiTracker roiTracker;
+        std::vector<double> samples;
+        long allocations = 0;
+        cv::Mat frame;
+        for (int n = 0; n < numFrames; n++){
+            generator.render(n, frame);
+            long before = threadAllocationCount();
+            watch.start();
+            Detection d = roiTracker.detect(frame, range, true, n);
+            samples.push_back(watch.stopMs());
+            //the window keeps changing size, so warm-up is the first few frames of the run
+            if (n >= WARMUP_FRAMES){allocations += threadAllocationCount() - before;}
+            if (isHit(d, generator.blobCenter(0, n))){roiHits++;}
+        }
+        results.push_back(summarize("RoiTracker::detect", samples, allocations));
+    }
+
+    //tile skipping keeps masks from frame to frame, so it also runs over a sequence. without the speckles only the
+    //blobs and the sensor noise change, as for a camera fixed on a gate.
+    {
+        SyntheticFrames still(size, seed);
+        still.numSpeckles = 0;
+        TileChangeDetector tiles;
+        std::vector<double> samples;
+        long allocations = 0;
+        cv::Mat frame, reference;
+        for (int n = 0; n < numFrames + WARMUP_FRAMES; n++){
+            still.render(n, frame);
+            long before = threadAllocationCount();
+            watch.start();
+            tiles.threshold(frame, range, true, threshold);
+            double ms = watch.stopMs();
+            if (n >= WARMUP_FRAMES){
+                samples.push_back(ms);
+                allocations += threadAllocationCount() - before;
+            }
+            hsvThreshold(frame, range, reference);
+            morphOps(reference);
+            if (!sameMask(reference, threshold)){tileMaskMismatches++;}
+        }
+        results.push_back(summarize("TileChangeDetector", samples, allocations));
+        tilesSkipped = tiles.total().skippedFraction();
+    }
+
+    //detection accuracy against the known blob positions
+    for (int i = 0; i < FRAME_POOL_SIZE; i++){
+        hsvThreshold(frames[i], range, threshold);
+        morphOps(threshold);
+        if (isHit(findFilteredObject(threshold), generator.blobCenter(0, i))){hits++;}
+        detectTargets(classifier, frames[i], true, masks, detections);
+        for (int t = 0; t < generator.numBlobs(); t++, targetSamples++){
+            if (isHit(detections[t], generator.blobCenter(t, i))){targetHits++;}
+        }
+    }
+
+    //allocation counts only exist in debug builds, where the timings are not representative anyway
+    bool countAllocations = allocationCountingEnabled();
+    printf("%-26s %10s %10s %10s %10s %9s%s\n", "stage", "mean ms", "p50 ms", "p99 ms", "max ms", "fps",
+           countAllocations ? "  allocs/frame" : "");
+    for (size_t i = 0; i < results.size(); i++){
+        const StageResult &r = results[i];
+        printf("%-26s %10.3f %10.3f %10.3f %10.3f %9.1f", r.name.c_str(), r.mean, r.p50, r.p99, r.max,
+               r.mean > 0 ? 1000.0/r.mean : 0.0);
+        if (countAllocations){printf("  %12.2f", r.allocations);}
+        printf("\n");
+    }
+    printf("detection hits: main object %d/%d, predictive %d/%d, gates %d/%d\n",
+           hits, FRAME_POOL_SIZE, roiHits, numFrames, targetHits, targetSamples);
+    printf("tile skipping: %.1f%% of tiles skipped, %d/%d masks differ from the full frame\n",
+           100*tilesSkipped, tileMaskMismatches, numFrames + WARMUP_FRAMES);
+
+    //coarse-to-fine against full resolution, on the sizes of every blob: each blob in turn is the object
+    printf("\n%-10s %10s %9s %12s %16s %14s\n", "decimation", "p50 ms", "speedup", "found agree", "centroid err px", "area err %");
+    for (int i = 0; i < NUM_DECIMATIONS; i++){
+        PyramidDetector full(1), pyramid(DECIMATIONS[i]);
+        int agree = 0, compared = 0, samples = 0;
+        double centroidError = 0, areaError = 0;
+        for (int f = 0; f < FRAME_POOL_SIZE; f++){
+            for (int t = 0; t < generator.numBlobs(); t++, samples++){
+                Detection reference = full.detect(frames[f], generator.blob(t).range, true);
+                Detection coarse = pyramid.detect(frames[f], generator.blob(t).range, true);
+                if (reference.found == coarse.found){agree++;}
+                if (reference.found && coarse.found){
+                    compared++;
+                    centroidError += std::sqrt((double)(coarse.x - reference.x)*(coarse.x - reference.x) + (double)(coarse.y - reference.y)*(coarse.y - reference.y));
+                    areaError += 100*std::fabs(coarse.area - reference.area)/reference.area;
+                }
+            }
+        }
+        printf("%-10s %10.3f %8.2fx %11.1f%% %16.2f %14.2f\n", (intToString(DECIMATIONS[i]) + "x").c_str(), pyramidResults[i].p50,
+               pyramidResults[i].p50 > 0 ? pyramidResults[0].p50/pyramidResults[i].p50 : 0.0, 100.0*agree/samples,
+               compared ? centroidError/compared : 0.0, compared ? areaError/compared : 0.0);
+    }
+
+    if (!csvFile.empty()){
+        std::ofstream out(csvFile.c_str());
+        out << "stage,mean_ms,p50_ms,p99_ms,max_ms\n";
+        for (size_t i = 0; i < results.size(); i++){
+            const StageResult &r = results[i];
+            out << r.name << "," << r.mean << "," << r.p50 << "," << r.p99 << "," << r.max << "\n";
+        }
+    }
+
+    int status = correct ? 0 : 1;
+    if (!baselineFile.empty()){
+        std::map<std::string, StageResult> baseline = readBaseline(baselineFile);
+        if (baseline.empty()){
+            std::cerr << "No stages in baseline " << baselineFile << std::endl;
+            return 1;
+        }
+        for (size_t i = 0; i < results.size(); i++){
+            std::map<std::string, StageResult>::const_iterator b = baseline.find(results[i].name);
+            if (b == baseline.end() || b->second.p50 <= 0){continue;}
+            double change = results[i].p50/b->second.p50 - 1;
+            if (change > tolerance){
+                printf("REGRESSION %-26s p50 %.3f ms vs %.3f ms (+%.0f%%)\n", results[i].name.c_str(),
+                       results[i].p50, b->second.p50, 100*change);
+                if (status == 0){status = 2;}
+            }
+        }
+    }
+    return status;
+}
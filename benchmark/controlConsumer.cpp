@@ -0,0 +1,211 @@
+/***************************************
+ Test consumer of the flight controller output channel.
+
+ Reads detections the way a flight controller would, from the shared memory
+ seqlock or from UDP datagrams, and reports the update rate, the samples it
+ missed and the handoff latency (publish to read) and capture to read
+ latency as p50/p99/max.
+
+ Usage:
+   quadRacingControlConsumer [--name /quadracing-control] [--seconds 10]
+   quadRacingControlConsumer --udp port [--seconds 10]
+   quadRacingControlConsumer --self-test [--rate 1000] [--seconds 5]
+
+ --self-test publishes from a thread of its own to a private shared memory
+ object at the given rate and checks every sample it reads for tearing. It
+ exits with status 1 if a sample was torn or nothing arrived.
+ ************************************/
+
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <iostream>
+#include <string>
+#include <thread>
+#include <unistd.h>
+#ifndef _WIN32
+#include <netinet/in.h>
+#include <sys/socket.h>
+#endif
+#include "flightOutput.h"
+#include "latencyStats.h"
+
+/// Everything the consumer measured.
+struct ConsumerStats {
+    long samples;    // distinct samples read
+    long missed;     // samples published between two reads that the reader never saw
+    long torn;       // self-test only: samples whose fields do not belong to the same frame
+    double seconds;
+    LatencyHistogram handoff;       // publish -> read
+    LatencyHistogram captureToRead; // camera capture -> read
+    ConsumerStats(): samples(0), missed(0), torn(0), seconds(0) {}
+};
+
+/// Self-test samples carry the frame index in every field, so a mix of two updates shows.
+static ControlSample selfTestSample(uint64_t frame){
+    ControlSample sample;
+    memset(&sample, 0, sizeof(sample));
+    sample.frameIndex = frame;
+    sample.captureTime = latencyClock();
+    sample.x = (int32_t)frame;
+    sample.y = -(int32_t)frame;
+    sample.area = (float)(frame % 1000);
+    sample.errorX = (float)(frame % 2000)/1000 - 1;
+    sample.found = 1;
+    return sample;
+}
+
+static bool consistent(const ControlSample &sample){
+    uint64_t frame = sample.frameIndex;
+    return sample.x == (int32_t)frame && sample.y == -(int32_t)frame && sample.area == (float)(frame % 1000)
+        && sample.errorX == (float)(frame % 2000)/1000 - 1;
+}
+
+static void account(ConsumerStats &stats, const ControlSample &sample, uint64_t sequence, uint64_t &lastSequence, bool selfTest){
+    double now = latencyClock();
+    if (stats.samples > 0 && sequence > lastSequence + 1){stats.missed += (long)(sequence - lastSequence - 1);}
+    lastSequence = sequence;
+    stats.samples++;
+    stats.handoff.record(now - sample.publishTime);
+    stats.captureToRead.record(now - sample.captureTime);
+    if (selfTest && !consistent(sample)){stats.torn++;}
+}
+
+/// Poll the seqlock until seconds have passed, counting each new sample once.
+static void consumeSharedMemory(const FlightOutputReader &reader, double seconds, bool selfTest, ConsumerStats &stats){
+    double start = latencyClock();
+    uint64_t lastSequence = 0, sequence;
+    bool seen = false;
+    ControlSample sample;
+    while (latencyClock() - start < seconds){
+        if (reader.read(sample, sequence) && (!seen || sequence != lastSequence)){
+            seen = true;
+            account(stats, sample, sequence, lastSequence, selfTest);
+        }else{
+            std::this_thread::yield();
+        }
+    }
+    stats.seconds = latencyClock() - start;
+}
+
+static bool consumeUdp(int port, double seconds, ConsumerStats &stats){
+#ifdef _WIN32
+    (void)port; (void)seconds; (void)stats;
+    return false;
+#else
+    int fd = socket(AF_INET, SOCK_DGRAM, 0);
+    sockaddr_in address;
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_addr.s_addr = htonl(INADDR_LOOPBACK);
+    address.sin_port = htons((uint16_t)port);
+    if (fd < 0 || bind(fd, (const sockaddr*)&address, sizeof(address)) != 0){
+        if (fd >= 0){close(fd);}
+        return false;
+    }
+    timeval timeout = {0, 100000};
+    setsockopt(fd, SOL_SOCKET, SO_RCVTIMEO, &timeout, sizeof(timeout));
+    double start = latencyClock();
+    uint64_t lastSequence = 0;
+    ControlDatagram datagram;
+    while (latencyClock() - start < seconds){
+        ssize_t n = recv(fd, &datagram, sizeof(datagram), 0);
+        if (n != (ssize_t)sizeof(datagram) || datagram.magic != FLIGHT_OUTPUT_MAGIC || datagram.version != FLIGHT_OUTPUT_VERSION){continue;}
+        account(stats, datagram.sample, datagram.sequence, lastSequence, false);
+    }
+    stats.seconds = latencyClock() - start;
+    close(fd);
+    return true;
+#endif
+}
+
+static void report(const ConsumerStats &stats, bool selfTest){
+    printf("%ld samples in %.1f s (%.1f per second), %ld missed\n", stats.samples, stats.seconds,
+           stats.seconds > 0 ? stats.samples/stats.seconds : 0, stats.missed);
+    printf("%-18s %9s %9s %9s\n", "latency", "p50 us", "p99 us", "max us");
+    printf("%-18s %9.1f %9.1f %9.1f\n", "publish->read", 1e6*stats.handoff.quantile(0.5), 1e6*stats.handoff.quantile(0.99), 1e6*stats.handoff.max());
+    printf("%-18s %9.1f %9.1f %9.1f\n", "capture->read", 1e6*stats.captureToRead.quantile(0.5), 1e6*stats.captureToRead.quantile(0.99), 1e6*stats.captureToRead.max());
+    if (selfTest){printf("%ld torn samples\n", stats.torn);}
+}
+
+int main(int argc, char* argv[]){
+    std::string name = DEFAULT_FLIGHT_OUTPUT_NAME;
+    double seconds = 10;
+    int udpPort = 0;
+    bool selfTest = false;
+    double rate = 1000;
+    bool secondsGiven = false;
+    for (int i = 1; i < argc; i++){
+        std::string arg = argv[i];
+        if (arg == "--name" && i + 1 < argc){
+            name = argv[++i];
+        }else if (arg == "--seconds" && i + 1 < argc){
+            seconds = atof(argv[++i]);
+            secondsGiven = true;
+        }else if (arg == "--udp" && i + 1 < argc){
+            udpPort = atoi(argv[++i]);
+        }else if (arg == "--self-test"){
+            selfTest = true;
+        }else if (arg == "--rate" && i + 1 < argc){
+            rate = std::max(1.0, atof(argv[++i]));
+        }else{
+            std::cerr << "Unknown option " << arg << std::endl;
+            return 1;
+        }
+    }
+
+    ConsumerStats stats;
+    if (udpPort > 0){
+        if (!consumeUdp(udpPort, seconds, stats)){
+            std::cerr << "Cannot listen on UDP port " << udpPort << std::endl;
+            return 1;
+        }
+        report(stats, false);
+        return 0;
+    }
+
+    if (!selfTest){
+        FlightOutputReader reader;
+        if (!reader.open(name)){
+            std::cerr << "Nothing publishes to " << name << ", is the tracker running?" << std::endl;
+            return 1;
+        }
+        consumeSharedMemory(reader, seconds, false, stats);
+        report(stats, false);
+        return 0;
+    }
+
+    //self-test: a writer thread at the given rate and this thread reading, through real shared memory
+    if (!secondsGiven){seconds = 5;}
+    std::string testName = "/quadracing-selftest-" + std::to_string((long)getpid());
+    FlightOutput output;
+    if (!output.openSharedMemory(testName)){
+        std::cerr << "Cannot create shared memory " << testName << std::endl;
+        return 1;
+    }
+    FlightOutputReader reader;
+    if (!reader.open(testName)){
+        std::cerr << "Cannot map shared memory " << testName << std::endl;
+        return 1;
+    }
+    std::atomic<bool> writing(true);
+    std::thread writer([&](){
+        std::chrono::steady_clock::time_point next = std::chrono::steady_clock::now();
+        std::chrono::nanoseconds period((long long)(1e9/rate));
+        for (uint64_t frame = 0; writing; frame++){
+            output.publish(selfTestSample(frame));
+            //sleep like the tracker between frames, so the reader gets the core even on a single CPU machine
+            next += period;
+            std::this_thread::sleep_until(next);
+        }
+    });
+    consumeSharedMemory(reader, seconds, true, stats);
+    writing = false;
+    writer.join();
+    report(stats, true);
+    printf("%llu samples published\n", (unsigned long long)output.publishedCount());
+    return stats.torn == 0 && stats.samples > 0 ? 0 : 1;
+}
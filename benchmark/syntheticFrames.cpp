@@ -0,0 +1,97 @@
+#include "syntheticFrames.h"
+
+#include <algorithm>
+#include <cmath>
+
+namespace {
+
+/// xorshift32. Frames must not depend on the OpenCV version, so cv::RNG is not used.
+inline uint32_t nextRandom(uint32_t &state){
+    state ^= state << 13;
+    state ^= state >> 17;
+    state ^= state << 5;
+    return state;
+}
+
+SyntheticBlob makeBlob(const char *name, cv::Scalar bgr, HSVRange range, int radius,
+                       double amplitudeX, double amplitudeY, double periodX, double periodY, double phase){
+    SyntheticBlob blob;
+    blob.name = name;
+    blob.bgr = bgr;
+    blob.range = range;
+    blob.radius = radius;
+    blob.amplitudeX = amplitudeX;
+    blob.amplitudeY = amplitudeY;
+    blob.periodX = periodX;
+    blob.periodY = periodY;
+    blob.phase = phase;
+    return blob;
+}
+
+} // namespace
+
+SyntheticFrames::SyntheticFrames(cv::Size frameSize, uint32_t frameSeed)
+: noiseAmplitude(6), numSpeckles(150), size(frameSize), seed(frameSeed ? frameSeed : 1) {
+    // hue 15, 60 and 150 at full or near full saturation. the background stays below saturation 60.
+    HSVRange orange = {5, 25, 150, 256, 150, 256};
+    HSVRange green = {50, 70, 120, 256, 120, 256};
+    HSVRange magenta = {140, 160, 140, 256, 140, 256};
+    int radius = std::max(8, size.height/18);
+    blobs.push_back(makeBlob("orange", cv::Scalar(0,128,255), orange, radius, 0.35, 0.30, 240, 170, 0.0));
+    blobs.push_back(makeBlob("green", cv::Scalar(60,200,60), green, radius*3/4, 0.30, 0.35, 310, 200, 1.7));
+    blobs.push_back(makeBlob("magenta", cv::Scalar(200,40,200), magenta, radius/2, 0.40, 0.25, 190, 260, 3.1));
+
+    // sky-to-ground shading with a coarse checker texture so the frame is not flat
+    background.create(size, CV_8UC3);
+    for (int y = 0; y < size.height; y++){
+        cv::Vec3b *row = background.ptr<cv::Vec3b>(y);
+        int shade = 150 - 70*y/std::max(1, size.height);
+        for (int x = 0; x < size.width; x++){
+            int texture = ((x/40 + y/40) & 1) ? 12 : 0;
+            int v = shade + texture;
+            row[x] = cv::Vec3b((uchar)std::min(255, v + 25), (uchar)std::min(255, v + 10), (uchar)v);
+        }
+    }
+}
+
+cv::Point SyntheticFrames::blobCenter(int id, long frameIndex) const {
+    const SyntheticBlob &b = blobs[id];
+    const double twoPi = 6.283185307179586;
+    double x = 0.5 + b.amplitudeX*std::sin(twoPi*frameIndex/b.periodX + b.phase);
+    double y = 0.5 + b.amplitudeY*std::sin(twoPi*frameIndex/b.periodY + 0.5*b.phase);
+    return cv::Point(cvRound(x*size.width), cvRound(y*size.height));
+}
+
+void SyntheticFrames::render(long frameIndex, cv::Mat &bgr) const {
+    background.copyTo(bgr);
+    for (int i = 0; i < numBlobs(); i++){
+        cv::circle(bgr, blobCenter(i, frameIndex), blobs[i].radius, blobs[i].bgr, -1, 8);
+    }
+
+    uint32_t state = seed*2654435761u ^ (uint32_t)(frameIndex + 1)*40503u;
+    if (!state){state = 1;}
+
+    // 3x3 speckles of the blob colors: visible to the threshold, removed by the 2x 3x3 erode
+    for (int i = 0; i < numSpeckles && size.width > 3 && size.height > 3; i++){
+        const SyntheticBlob &b = blobs[nextRandom(state) % blobs.size()];
+        int x = (int)(nextRandom(state) % (uint32_t)(size.width - 3));
+        int y = (int)(nextRandom(state) % (uint32_t)(size.height - 3));
+        bgr(cv::Rect(x, y, 3, 3)).setTo(b.bgr);
+    }
+
+    // sensor noise, one random word per 4 channel values
+    if (noiseAmplitude > 0){
+        int span = 2*noiseAmplitude + 1;
+        for (int y = 0; y < size.height; y++){
+            uchar *p = bgr.ptr<uchar>(y);
+            int n = size.width*3;
+            for (int x = 0; x < n; x += 4){
+                uint32_t r = nextRandom(state);
+                for (int k = 0; k < 4 && x + k < n; k++, r >>= 8){
+                    int v = p[x + k] + (int)((r & 0xFF) % span) - noiseAmplitude;
+                    p[x + k] = (uchar)std::min(255, std::max(0, v));
+                }
+            }
+        }
+    }
+}
@@ -0,0 +1,54 @@
+/***************************************
+ Deterministic synthetic camera frames for the benchmark.
+
+ A shaded, low-saturation background with a few colored discs (the "gates")
+ moving on fixed Lissajous paths, plus per-pixel sensor noise and small
+ colored speckles that the morphology has to remove. The same seed and frame
+ index always give the same frame, so runs on different machines and
+ compilers see identical input.
+ ************************************/
+
+#ifndef SYNTHETIC_FRAMES_H
+#define SYNTHETIC_FRAMES_H
+
+#include <opencv2/opencv.hpp>
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include "hsvThreshold.h"
+
+/// One moving colored disc and the HSV bounds that pick it out.
+struct SyntheticBlob {
+    std::string name;
+    cv::Scalar bgr;
+    HSVRange range;
+    int radius;
+    double amplitudeX, amplitudeY; // fraction of the frame size
+    double periodX, periodY;       // frames per oscillation
+    double phase;
+};
+
+class SyntheticFrames {
+public:
+    explicit SyntheticFrames(cv::Size size, uint32_t seed = 1);
+
+    /// Draw frame frameIndex into bgr (CV_8UC3).
+    void render(long frameIndex, cv::Mat &bgr) const;
+    /// True center of a blob in frame frameIndex.
+    cv::Point blobCenter(int blob, long frameIndex) const;
+
+    int numBlobs() const {return (int)blobs.size();}
+    const SyntheticBlob &blob(int id) const {return blobs[id];}
+    cv::Size frameSize() const {return size;}
+
+    int noiseAmplitude;  // per-channel sensor noise is uniform in [-noiseAmplitude, noiseAmplitude]
+    int numSpeckles;     // small colored patches per frame, too small to survive the erode
+
+private:
+    cv::Size size;
+    uint32_t seed;
+    cv::Mat background;
+    std::vector<SyntheticBlob> blobs;
+};
+
+#endif
@@ -0,0 +1,211 @@
+#include "binaryMorphology.h"
+
+#include <algorithm>
+#include <cstring>
+
+namespace {
+
+/// out[x] = in[x + s], reading fill for pixels outside the row.
+void shiftRow(const uint64_t *in, uint64_t *out, int words, int s, uint64_t fill){
+    if (s == 0){
+        memcpy(out, in, words*sizeof(uint64_t));
+    }else if (s > 0){
+        int q = s >> 6, r = s & 63;
+        for (int j = 0; j < words; j++){
+            uint64_t a = j + q < words ? in[j + q] : fill;
+            uint64_t b = j + q + 1 < words ? in[j + q + 1] : fill;
+            out[j] = r ? (a >> r) | (b << (64 - r)) : a;
+        }
+    }else{
+        int t = -s, q = t >> 6, r = t & 63;
+        for (int j = 0; j < words; j++){
+            uint64_t a = j - q >= 0 ? in[j - q] : fill;
+            uint64_t b = j - q - 1 >= 0 ? in[j - q - 1] : fill;
+            out[j] = r ? (a << r) | (b >> (64 - r)) : a;
+        }
+    }
+}
+
+inline void combine(uint64_t *dst, const uint64_t *src, int words, bool isAnd){
+    if (isAnd){
+        for (int j = 0; j < words; j++){dst[j] &= src[j];}
+    }else{
+        for (int j = 0; j < words; j++){dst[j] |= src[j];}
+    }
+}
+
+/// 8 bits -> 8 bytes of 0 / 255
+struct ExpandTable {
+    uint64_t bytes[256];
+    ExpandTable(){
+        for (int b = 0; b < 256; b++){
+            uint64_t v = 0;
+            for (int i = 0; i < 8; i++){
+                if (b & (1 << i)){v |= (uint64_t)0xFF << (8*i);}
+            }
+            bytes[b] = v;
+        }
+    }
+};
+
+const ExpandTable &expandTable(){
+    static const ExpandTable table;
+    return table;
+}
+
+/// Offsets [lo, hi] covered by iterations passes of a size long element with the default (centered) anchor.
+void elementRange(int size, int iterations, int &lo, int &hi){
+    int anchor = size/2;
+    lo = -anchor*iterations;
+    hi = (size - 1 - anchor)*iterations;
+}
+
+/// a[x] = op over src[x + direction*k] for k in [0, length), built by doubling:
+/// a run of length 2m is two runs of length m, and a final overlapping pair covers the rest.
+void rowRun(const uint64_t *src, uint64_t *a, uint64_t *b, int words, int length, int direction, uint64_t fill, bool isAnd){
+    memcpy(a, src, words*sizeof(uint64_t));
+    int m = 1;
+    for (; 2*m <= length; m *= 2){
+        shiftRow(a, b, words, direction*m, fill);
+        combine(a, b, words, isAnd);
+    }
+    if (length > m){
+        shiftRow(a, b, words, direction*(length - m), fill);
+        combine(a, b, words, isAnd);
+    }
+}
+
+/// Same as rowRun down (direction 1) or up (direction -1) the columns of a rows x words image, in place.
+/// Whole packed rows are the unit, so every operation is word wide.
+void columnRun(uint64_t *image, const uint64_t *fillRow, int rows, int words, int length, int direction, bool isAnd){
+    int m = 1;
+    for (;;){
+        int step;
+        if (2*m <= length){
+            step = m;
+        }else if (length > m){
+            step = length - m;
+        }else{
+            break;
+        }
+        // walk away from the rows being read, so they still hold the previous level
+        for (int i = 0; i < rows; i++){
+            int y = direction > 0 ? i : rows - 1 - i;
+            int other = y + direction*step;
+            combine(&image[(size_t)y*words], other >= 0 && other < rows ? &image[(size_t)other*words] : fillRow, words, isAnd);
+        }
+        if (step != m){break;}
+        m *= 2;
+    }
+}
+
+} // namespace
+
+void BinaryMorphology::pack(const cv::Mat &src){
+    rows = src.rows;
+    cols = src.cols;
+    words = (cols + 63)/64;
+    paddingMask = (cols & 63) ? ~(((uint64_t)1 << (cols & 63)) - 1) : 0;
+    bits.resize((size_t)rows*words);
+    rowA.resize(words);
+    rowB.resize(words);
+    rowC.resize(words);
+    fillRow.resize(words);
+
+    for (int y = 0; y < rows; y++){
+        const uchar *p = src.ptr<uchar>(y);
+        uint64_t *row = &bits[(size_t)y*words];
+        int x = 0;
+        for (int j = 0; j < words; j++){
+            uint64_t word = 0;
+            int end = std::min(x + 64, cols);
+            // gather the top bit of 8 bytes at a time
+            for (int shift = 0; x + 8 <= end; x += 8, shift += 8){
+                uint64_t v;
+                memcpy(&v, p + x, 8);
+                v &= 0x8080808080808080ULL;
+                word |= ((v*0x0002040810204081ULL) >> 56) << shift;
+            }
+            for (; x < end; x++){
+                if (p[x] & 0x80){word |= (uint64_t)1 << (x & 63);}
+            }
+            row[j] = word;
+        }
+    }
+}
+
+void BinaryMorphology::unpack(cv::Mat &dst) const {
+    const ExpandTable &table = expandTable();
+    dst.create(rows, cols, CV_8UC1);
+    for (int y = 0; y < rows; y++){
+        uchar *p = dst.ptr<uchar>(y);
+        const uint64_t *row = &bits[(size_t)y*words];
+        int x = 0;
+        for (; x + 8 <= cols; x += 8){
+            memcpy(p + x, &table.bytes[(row[x >> 6] >> (x & 63)) & 0xFF], 8);
+        }
+        for (; x < cols; x++){
+            p[x] = (row[x >> 6] >> (x & 63)) & 1 ? 255 : 0;
+        }
+    }
+}
+
+void BinaryMorphology::setPadding(uint64_t fill){
+    for (int j = 0; j < words; j++){fillRow[j] = fill;}
+    if (!paddingMask){return;}
+    for (int y = 0; y < rows; y++){
+        uint64_t &last = bits[(size_t)y*words + words - 1];
+        last = (last & ~paddingMask) | (fill & paddingMask);
+    }
+}
+
+/// row[x] = op over row[x + lo .. x + hi]: a run to the right (0..hi) combined with a run to the left (lo..0),
+/// so pixels past either edge only ever come from the fill value.
+void BinaryMorphology::rowWindow(int lo, int hi, bool isAnd){
+    const uint64_t fill = isAnd ? ~(uint64_t)0 : 0;
+    for (int y = 0; y < rows; y++){
+        uint64_t *row = &bits[(size_t)y*words];
+        rowRun(row, &rowA[0], &rowB[0], words, hi + 1, 1, fill, isAnd);
+        rowRun(row, &rowC[0], &rowB[0], words, 1 - lo, -1, fill, isAnd);
+        memcpy(row, &rowA[0], words*sizeof(uint64_t));
+        combine(row, &rowC[0], words, isAnd);
+        row[words - 1] = (row[words - 1] & ~paddingMask) | (fill & paddingMask);
+    }
+}
+
+/// Column counterpart of rowWindow. The upward run works on a copy of the image.
+void BinaryMorphology::columnWindow(int lo, int hi, bool isAnd){
+    scratch = bits;
+    columnRun(&bits[0], &fillRow[0], rows, words, hi + 1, 1, isAnd);
+    columnRun(&scratch[0], &fillRow[0], rows, words, 1 - lo, -1, isAnd);
+    combine(&bits[0], &scratch[0], (int)bits.size(), isAnd);
+}
+
+void BinaryMorphology::erodeDilate(const cv::Mat &src, cv::Mat &dst, cv::Size erodeSize, int erodeIterations,
+                                   cv::Size dilateSize, int dilateIterations){
+    CV_Assert(src.type() == CV_8UC1);
+    if (src.empty()){
+        src.copyTo(dst);
+        return;
+    }
+    pack(src);
+    int lo, hi;
+
+    // erode: pixels outside the image count as set, like OpenCV's default erode border
+    if (erodeIterations > 0){
+        setPadding(~(uint64_t)0);
+        elementRange(erodeSize.width, erodeIterations, lo, hi);
+        rowWindow(lo, hi, true);
+        elementRange(erodeSize.height, erodeIterations, lo, hi);
+        columnWindow(lo, hi, true);
+    }
+    // dilate: pixels outside the image count as clear
+    if (dilateIterations > 0){
+        setPadding(0);
+        elementRange(dilateSize.width, dilateIterations, lo, hi);
+        rowWindow(lo, hi, false);
+        elementRange(dilateSize.height, dilateIterations, lo, hi);
+        columnWindow(lo, hi, false);
+    }
+    unpack(dst);
+}
@@ -0,0 +1,43 @@
+/***************************************
+ Bit-packed binary morphology for 0/255 masks.
+
+ The mask is packed to 1 bit per pixel (64 pixels per word) and rectangular
+ erode/dilate are split into separable row and column passes that use
+ word-wide AND/OR. Repeated iterations of a rectangular element are fused
+ into one wider element, so morphOps()' 2 erodes + 4 dilates become one
+ erode and one dilate. A window of width w costs about log2(w) word passes.
+
+ Results are bit-identical to cv::erode / cv::dilate with a MORPH_RECT
+ element, the default anchor and the default border, as long as the input
+ only holds 0 and 255 (what hsvThreshold produces).
+ ************************************/
+
+#ifndef BINARY_MORPHOLOGY_H
+#define BINARY_MORPHOLOGY_H
+
+#include <opencv2/opencv.hpp>
+#include <stdint.h>
+#include <vector>
+
+class BinaryMorphology {
+public:
+    /// Erode with an erodeSize rectangle erodeIterations times, then dilate with a dilateSize rectangle
+    /// dilateIterations times. src and dst may be the same Mat.
+    void erodeDilate(const cv::Mat &src, cv::Mat &dst, cv::Size erodeSize, int erodeIterations,
+                     cv::Size dilateSize, int dilateIterations);
+
+private:
+    void pack(const cv::Mat &src);
+    void unpack(cv::Mat &dst) const;
+    void setPadding(uint64_t fill);
+    void rowWindow(int lo, int hi, bool isAnd);
+    void columnWindow(int lo, int hi, bool isAnd);
+
+    int rows, cols, words;
+    uint64_t paddingMask;         // bits of the last word in each row that lie outside the image
+    std::vector<uint64_t> bits;   // rows x words, bit i of word j is pixel 64*j + i
+    std::vector<uint64_t> scratch;  // copy of bits for the upward column pass
+    std::vector<uint64_t> rowA, rowB, rowC, fillRow;
+};
+
+#endif
@@ -0,0 +1,187 @@
+#include "blobExtractor.h"
+
+#include <algorithm>
+#include <cstring>
+#include <thread>
+
+namespace {
+
+typedef BlobExtractor::Run Run;
+typedef BlobExtractor::Strip Strip;
+
+int findRoot(std::vector<int> &parent, int label){
+    int root = label;
+    while (parent[root] != root){root = parent[root];}
+    while (parent[label] != root){
+        int next = parent[label];
+        parent[label] = root;
+        label = next;
+    }
+    return root;
+}
+
+/// Merge two sets, keeping the smaller label as root. Returns the root.
+int unite(std::vector<int> &parent, int a, int b){
+    a = findRoot(parent, a);
+    b = findRoot(parent, b);
+    if (a == b){return a;}
+    if (a < b){
+        parent[b] = a;
+        return a;
+    }
+    parent[a] = b;
+    return b;
+}
+
+void addRun(Blob &blob, int start, int end, int y){
+    int length = end - start + 1;
+    blob.area += length;
+    blob.sumX += (int64_t)(start + end)*length/2;
+    blob.sumY += (int64_t)y*length;
+    blob.minX = std::min(blob.minX, start);
+    blob.maxX = std::max(blob.maxX, end);
+    blob.minY = std::min(blob.minY, y);
+    blob.maxY = std::max(blob.maxY, y);
+}
+
+void mergeBlob(Blob &into, const Blob &from){
+    into.area += from.area;
+    into.sumX += from.sumX;
+    into.sumY += from.sumY;
+    into.minX = std::min(into.minX, from.minX);
+    into.maxX = std::max(into.maxX, from.maxX);
+    into.minY = std::min(into.minY, from.minY);
+    into.maxY = std::max(into.maxY, from.maxY);
+}
+
+/// Append the runs of nonzero pixels in one row. Zero and 255 areas are skipped 8 bytes at a time.
+void findRuns(const uchar *p, int cols, std::vector<Run> &runs){
+    runs.clear();
+    int x = 0;
+    while (x < cols){
+        uint64_t word;
+        while (x + 8 <= cols){
+            memcpy(&word, p + x, 8);
+            if (word != 0){break;}
+            x += 8;
+        }
+        while (x < cols && p[x] == 0){x++;}
+        if (x >= cols){break;}
+        int start = x;
+        while (x + 8 <= cols){
+            memcpy(&word, p + x, 8);
+            if (word != ~(uint64_t)0){break;}
+            x += 8;
+        }
+        while (x < cols && p[x] != 0){x++;}
+        Run run = {start, x - 1, -1};
+        runs.push_back(run);
+    }
+}
+
+/// For every run in current, union it with the runs of previous it touches (8-connectivity).
+/// Runs without a neighbour are given to newLabel. Both lists are sorted by start.
+template <typename NewLabel>
+void connectRuns(std::vector<Run> &current, const std::vector<Run> &previous, std::vector<int> &parent, NewLabel newLabel){
+    size_t j = 0;
+    for (size_t i = 0; i < current.size(); i++){
+        Run &run = current[i];
+        while (j < previous.size() && previous[j].end < run.start - 1){j++;}
+        int label = run.label;
+        for (size_t k = j; k < previous.size() && previous[k].start <= run.end + 1; k++){
+            label = label < 0 ? findRoot(parent, previous[k].label) : unite(parent, label, previous[k].label);
+        }
+        if (label < 0){label = newLabel();}
+        run.label = label;
+    }
+}
+
+void labelStrip(const cv::Mat &mask, Strip &strip){
+    strip.parent.clear();
+    strip.stats.clear();
+    strip.previousRuns.clear();
+    std::vector<int> &parent = strip.parent;
+    std::vector<Blob> &stats = strip.stats;
+    struct NewLabel {
+        std::vector<int> &parent;
+        std::vector<Blob> &stats;
+        int operator()() const {
+            int label = (int)parent.size();
+            parent.push_back(label);
+            Blob empty = {0, 0, 0, 0x7fffffff, 0x7fffffff, -1, -1};
+            stats.push_back(empty);
+            return label;
+        }
+    } newLabel = {parent, stats};
+
+    for (int y = strip.firstRow; y < strip.endRow; y++){
+        findRuns(mask.ptr<uchar>(y), mask.cols, strip.currentRuns);
+        connectRuns(strip.currentRuns, strip.previousRuns, parent, newLabel);
+        // statistics go to whichever label the run had at the time, they are summed into the roots at the end
+        for (size_t i = 0; i < strip.currentRuns.size(); i++){
+            const Run &run = strip.currentRuns[i];
+            addRun(stats[run.label], run.start, run.end, y);
+        }
+        if (y == strip.firstRow){strip.firstRuns = strip.currentRuns;}
+        strip.previousRuns.swap(strip.currentRuns);
+    }
+}
+
+} // namespace
+
+const std::vector<Blob> &BlobExtractor::extract(const cv::Mat &mask, int numStrips){
+    CV_Assert(mask.type() == CV_8UC1);
+    numStrips = std::max(1, std::min(numStrips, mask.rows/8));
+    strips.resize(numStrips);
+    for (int s = 0; s < numStrips; s++){
+        strips[s].firstRow = (int)((long)mask.rows*s/numStrips);
+        strips[s].endRow = (int)((long)mask.rows*(s + 1)/numStrips);
+    }
+
+    if (numStrips == 1){
+        labelStrip(mask, strips[0]);
+    }else{
+        std::vector<std::thread> workers;
+        for (int s = 1; s < numStrips; s++){
+            workers.push_back(std::thread(labelStrip, std::cref(mask), std::ref(strips[s])));
+        }
+        labelStrip(mask, strips[0]);
+        for (size_t i = 0; i < workers.size(); i++){workers[i].join();}
+    }
+
+    // one global union-find over all strip labels, stitched along the strip borders
+    parent.clear();
+    offsets.resize(numStrips);
+    for (int s = 0; s < numStrips; s++){
+        offsets[s] = (int)parent.size();
+        for (size_t i = 0; i < strips[s].parent.size(); i++){
+            parent.push_back(strips[s].parent[i] + offsets[s]);
+        }
+    }
+    for (int s = 1; s < numStrips; s++){
+        // the runs of the last row of strip s-1 are still in its previousRuns. the runs of the first row of
+        // strip s keep their own label, so connectRuns unites it with every run above that they touch.
+        above.assign(strips[s - 1].previousRuns.begin(), strips[s - 1].previousRuns.end());
+        below.assign(strips[s].firstRuns.begin(), strips[s].firstRuns.end());
+        for (size_t i = 0; i < above.size(); i++){above[i].label += offsets[s - 1];}
+        for (size_t i = 0; i < below.size(); i++){below[i].label += offsets[s];}
+        connectRuns(below, above, parent, [](){return -1;});
+    }
+
+    // sum the statistics of every label into its root
+    blobs.clear();
+    rootIndex.assign(parent.size(), -1);
+    for (int s = 0; s < numStrips; s++){
+        for (size_t i = 0; i < strips[s].stats.size(); i++){
+            int label = (int)i + offsets[s];
+            int root = findRoot(parent, label);
+            if (rootIndex[root] < 0){
+                rootIndex[root] = (int)blobs.size();
+                blobs.push_back(strips[s].stats[i]);
+            }else{
+                mergeBlob(blobs[rootIndex[root]], strips[s].stats[i]);
+            }
+        }
+    }
+    return blobs;
+}
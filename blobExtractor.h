@@ -0,0 +1,60 @@
+/***************************************
+ Single-pass connected-components blob extraction.
+
+ The mask is scanned once, row by row, as runs of foreground pixels. Runs
+ that touch a run in the previous row (8-connectivity) are merged with a
+ union-find, and area, centroid sums and bounding box are accumulated per
+ run, so every blob's statistics are ready after one sweep with no copy of
+ the mask and no contour tracing.
+
+ The rows can optionally be split into horizontal strips that are labeled on
+ separate threads, then stitched along the strip borders.
+ ************************************/
+
+#ifndef BLOB_EXTRACTOR_H
+#define BLOB_EXTRACTOR_H
+
+#include <opencv2/opencv.hpp>
+#include <stdint.h>
+#include <vector>
+
+/// Statistics of one 8-connected blob of foreground pixels.
+struct Blob {
+    int area;              // number of pixels
+    int64_t sumX, sumY;    // sum of the pixel coordinates, centroid = sum/area
+    int minX, minY, maxX, maxY;
+
+    cv::Rect boundingBox() const {return cv::Rect(minX, minY, maxX - minX + 1, maxY - minY + 1);}
+    double centroidX() const {return (double)sumX/area;}
+    double centroidY() const {return (double)sumY/area;}
+};
+
+class BlobExtractor {
+public:
+    /// Find every blob of nonzero pixels in a CV_8UC1 mask. numStrips > 1 labels that many
+    /// horizontal strips in parallel. The returned vector stays valid until the next call.
+    const std::vector<Blob> &extract(const cv::Mat &mask, int numStrips = 1);
+
+    /// Horizontal run of foreground pixels [start, end] and its provisional label.
+    struct Run {
+        int start, end;
+        int label;
+    };
+    /// Labels of one strip of rows. Label numbers are local to the strip.
+    struct Strip {
+        int firstRow, endRow;
+        std::vector<int> parent;
+        std::vector<Blob> stats;
+        std::vector<Run> firstRuns, previousRuns, currentRuns;
+    };
+
+private:
+    std::vector<Strip> strips;
+    std::vector<int> parent;
+    std::vector<int> offsets;     // first global label of each strip
+    std::vector<Run> above, below; // strip border runs relabeled for stitching
+    std::vector<int> rootIndex;
+    std::vector<Blob> blobs;
+};
+
+#endif
@@ -0,0 +1,225 @@
+#include "calibrationProfile.h"
+
+#include <cstdio>
+#include <cstring>
+#include <fstream>
+#include <vector>
+
+#ifndef _WIN32
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#else
+#include <io.h>
+#endif
+
+//the table starts on a page boundary so it is mapped page-aligned
+const uint64_t PROFILE_TABLE_ALIGNMENT = 4096;
+
+/// FNV-1a over 64-bit words rather than bytes, so checking a 16 MB table stays in the milliseconds.
+static uint64_t fnv1a(const void *data, size_t bytes, uint64_t hash = 14695981039346656037ULL){
+    const uchar *p = static_cast<const uchar*>(data);
+    size_t i = 0;
+    for (; i + 8 <= bytes; i += 8){
+        uint64_t word;
+        memcpy(&word, p + i, 8);
+        hash ^= word;
+        hash *= 1099511628211ULL;
+    }
+    for (; i < bytes; i++){
+        hash ^= p[i];
+        hash *= 1099511628211ULL;
+    }
+    return hash;
+}
+
+static uint64_t profileChecksum(const ProfileHeader &header, const uchar *table){
+    ProfileHeader blank = header;
+    blank.checksum = 0;
+    uint64_t hash = fnv1a(&blank, sizeof(blank));
+    return fnv1a(table, (size_t)header.tableBytes, hash);
+}
+
+static void packRange(const HSVRange &range, int32_t *out){
+    out[0] = range.hMin; out[1] = range.hMax;
+    out[2] = range.sMin; out[3] = range.sMax;
+    out[4] = range.vMin; out[5] = range.vMax;
+}
+
+static HSVRange unpackRange(const int32_t *in){
+    HSVRange range = {in[0], in[1], in[2], in[3], in[4], in[5]};
+    return range;
+}
+
+/// Flush out's buffers and have the OS put its data on disk.
+static bool syncFile(FILE *out){
+    if (fflush(out) != 0){return false;}
+#ifndef _WIN32
+    return fsync(fileno(out)) == 0;
+#else
+    return _commit(_fileno(out)) == 0;
+#endif
+}
+
+/// Put the directory entry of file on disk, so a rename into it survives a power loss. Windows has no
+/// equivalent for directories, the rename is as durable as NTFS makes it there.
+static bool syncDirectory(const std::string &file){
+#ifndef _WIN32
+    size_t slash = file.find_last_of('/');
+    std::string directory = slash == std::string::npos ? "." : slash == 0 ? "/" : file.substr(0, slash);
+    int fd = ::open(directory.c_str(), O_RDONLY);
+    if (fd < 0){return false;}
+    bool synced = fsync(fd) == 0;
+    ::close(fd);
+    return synced;
+#else
+    (void)file;
+    return true;
+#endif
+}
+
+bool saveCalibrationProfile(const std::string &file, const HSVRange &object, const ColorClassifier *gates){
+    ProfileHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, CALIBRATION_PROFILE_MAGIC, sizeof(header.magic));
+    header.version = CALIBRATION_PROFILE_VERSION;
+    header.headerBytes = sizeof(ProfileHeader);
+    packRange(object, header.object);
+    const uchar *table = 0;
+    if (gates && gates->numTargets() > 0){
+        header.quantizationBits = gates->quantizationBits();
+        header.numTargets = gates->numTargets();
+        for (int t = 0; t < gates->numTargets(); t++){
+            strncpy(header.targets[t].name, gates->target(t).name.c_str(), PROFILE_NAME_LENGTH - 1);
+            packRange(gates->target(t).range, header.targets[t].range);
+        }
+        table = &gates->table()[0];
+        header.tableBytes = gates->table().size();
+    }
+    header.tableOffset = (sizeof(ProfileHeader) + PROFILE_TABLE_ALIGNMENT - 1)/PROFILE_TABLE_ALIGNMENT*PROFILE_TABLE_ALIGNMENT;
+    header.checksum = profileChecksum(header, table);
+
+    //the new profile is on disk before it replaces the old one, otherwise a power loss right after the rename
+    //could leave the name pointing at an empty or partial file
+    std::string temporary = file + ".tmp";
+    FILE *out = fopen(temporary.c_str(), "wb");
+    if (!out){return false;}
+    std::vector<char> padding((size_t)header.tableOffset - sizeof(header), 0);
+    bool written = fwrite(&header, sizeof(header), 1, out) == 1 &&
+                   (padding.empty() || fwrite(&padding[0], 1, padding.size(), out) == padding.size()) &&
+                   (!table || fwrite(table, 1, (size_t)header.tableBytes, out) == header.tableBytes) &&
+                   syncFile(out);
+    written = fclose(out) == 0 && written;
+    if (!written){
+        remove(temporary.c_str());
+        return false;
+    }
+#ifdef _WIN32
+    //rename() does not replace an existing file here
+    remove(file.c_str());
+#endif
+    if (rename(temporary.c_str(), file.c_str()) != 0){
+        remove(temporary.c_str());
+        return false;
+    }
+    return syncDirectory(file);
+}
+
+namespace {
+
+/// Read-only view of a whole file: mapped where mmap exists, read into memory otherwise.
+class FileView {
+public:
+    FileView(): data(0), size(0), mapped(false) {}
+    ~FileView(){
+#ifndef _WIN32
+        if (mapped){munmap((void*)data, size);}
+#endif
+    }
+    bool open(const std::string &file){
+#ifndef _WIN32
+        int fd = ::open(file.c_str(), O_RDONLY);
+        if (fd < 0){return false;}
+        struct stat info;
+        void *memory = MAP_FAILED;
+        if (fstat(fd, &info) == 0 && info.st_size > 0){
+            size = (size_t)info.st_size;
+            memory = mmap(0, size, PROT_READ, MAP_PRIVATE, fd, 0);
+        }
+        ::close(fd);
+        if (memory == MAP_FAILED){return false;}
+        data = static_cast<const uchar*>(memory);
+        mapped = true;
+        return true;
+#else
+        std::ifstream in(file.c_str(), std::ios::binary);
+        if (!in){return false;}
+        buffer.assign(std::istreambuf_iterator<char>(in), std::istreambuf_iterator<char>());
+        data = buffer.empty() ? 0 : (const uchar*)&buffer[0];
+        size = buffer.size();
+        return data != 0;
+#endif
+    }
+
+    const uchar *data;
+    size_t size;
+
+private:
+    FileView(const FileView &);
+    FileView &operator=(const FileView &);
+
+    bool mapped;
+    std::vector<char> buffer;
+};
+
+} // namespace
+
+bool loadCalibrationProfile(const std::string &file, CalibrationProfile &profile, std::string &error){
+    FileView view;
+    if (!view.open(file)){
+        error = "cannot read " + file;
+        return false;
+    }
+    ProfileHeader header;
+    if (view.size < sizeof(header)){
+        error = "not a calibration profile";
+        return false;
+    }
+    memcpy(&header, view.data, sizeof(header));
+    if (memcmp(header.magic, CALIBRATION_PROFILE_MAGIC, sizeof(header.magic)) != 0){
+        error = "not a calibration profile";
+        return false;
+    }
+    if (header.version != CALIBRATION_PROFILE_VERSION || header.headerBytes != sizeof(ProfileHeader)){
+        error = "unsupported profile version";
+        return false;
+    }
+    bool hasTable = header.numTargets > 0;
+    if (header.numTargets > (uint32_t)MAX_TARGETS ||
+        (hasTable && (header.quantizationBits < 1 || header.quantizationBits > 8 ||
+                      header.tableBytes != (uint64_t)1 << (3*header.quantizationBits))) ||
+        (!hasTable && header.tableBytes != 0) ||
+        header.tableOffset < sizeof(header) || header.tableOffset > view.size || header.tableBytes > view.size - header.tableOffset){
+        error = "truncated or inconsistent profile";
+        return false;
+    }
+    const uchar *table = view.data + header.tableOffset;
+    if (profileChecksum(header, table) != header.checksum){
+        error = "checksum mismatch";
+        return false;
+    }
+
+    profile.object = unpackRange(header.object);
+    profile.gates.reset();
+    if (hasTable){
+        std::vector<ColorTarget> targets(header.numTargets);
+        for (uint32_t t = 0; t < header.numTargets; t++){
+            header.targets[t].name[PROFILE_NAME_LENGTH - 1] = 0;
+            targets[t].name = header.targets[t].name;
+            targets[t].range = unpackRange(header.targets[t].range);
+        }
+        profile.gates = std::make_shared<ColorClassifier>((int)header.quantizationBits, targets, table);
+    }
+    return true;
+}
@@ -0,0 +1,65 @@
+/***************************************
+ Calibration profiles: the thresholds of a session, saved for the next one.
+
+ A profile holds the tracked object's HSV bounds and the gate targets
+ together with their precomputed classification table, so a restart skips
+ objectInitialization() and the table build and tracks the first frame.
+ The file is a fixed-size header followed by the table, which starts on a
+ page boundary. Loading maps the file, checks it and copies the table out,
+ so nothing is recomputed.
+
+ Profiles are written to a temporary file, which is synced to disk and
+ then renamed over the old one; the directory is synced after the rename.
+ A crash or power loss while saving leaves the previous profile or the
+ complete new one in place.
+
+ Layout (host byte order): ProfileHeader, padding up to tableOffset, then
+ tableBytes of table as returned by ColorClassifier::table(). The checksum
+ is FNV-1a, taken 64 bits at a time, over the header (checksum field
+ zeroed) and the table.
+ ************************************/
+
+#ifndef CALIBRATION_PROFILE_H
+#define CALIBRATION_PROFILE_H
+
+#include <memory>
+#include <stdint.h>
+#include <string>
+#include "colorClassifier.h"
+#include "hsvThreshold.h"
+
+const char CALIBRATION_PROFILE_MAGIC[8] = {'Q','R','C','A','L','I','B','1'};
+const uint32_t CALIBRATION_PROFILE_VERSION = 1;
+//longest gate name a profile keeps, including the terminating 0
+const int PROFILE_NAME_LENGTH = 48;
+
+struct ProfileTarget {
+    char name[PROFILE_NAME_LENGTH];
+    int32_t range[6]; // hMin, hMax, sMin, sMax, vMin, vMax
+};
+
+struct ProfileHeader {
+    char magic[8];
+    uint32_t version;
+    uint32_t headerBytes;       // sizeof(ProfileHeader), catches a layout change without a version bump
+    int32_t object[6];          // tracked object bounds
+    uint32_t quantizationBits;  // of the gate table
+    uint32_t numTargets;
+    ProfileTarget targets[MAX_TARGETS];
+    uint64_t tableOffset;
+    uint64_t tableBytes;        // 0 when there are no gate targets
+    uint64_t checksum;
+};
+
+struct CalibrationProfile {
+    HSVRange object;
+    std::shared_ptr<const ColorClassifier> gates; // 0 when the profile has no gate targets
+};
+
+/// Write object and gates (may be 0) to file, replacing it only once the new profile is complete and on disk.
+/// False if it could not be written, or the rename could not be synced.
+bool saveCalibrationProfile(const std::string &file, const HSVRange &object, const ColorClassifier *gates);
+/// Read a profile written by saveCalibrationProfile(). On failure profile is untouched and error says why.
+bool loadCalibrationProfile(const std::string &file, CalibrationProfile &profile, std::string &error);
+
+#endif
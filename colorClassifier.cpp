@@ -0,0 +1,84 @@
+#include "colorClassifier.h"
+#include "objectTracking.h"
+
+#include <algorithm>
+
+ColorClassifier::ColorClassifier(int quantizationBits)
+: bits(std::min(std::max(quantizationBits, 1), 8)) {
+    lut.assign((size_t)1 << (3*bits), 0);
+}
+
+ColorClassifier::ColorClassifier(int quantizationBits, const std::vector<ColorTarget> &restored, const uchar *table)
+: bits(std::min(std::max(quantizationBits, 1), 8)), targets(restored) {
+    if (targets.size() > (size_t)MAX_TARGETS){targets.resize(MAX_TARGETS);}
+    lut.assign(table, table + ((size_t)1 << (3*bits)));
+}
+
+int ColorClassifier::addTarget(const std::string &name, const HSVRange &range){
+    if ((int)targets.size() >= MAX_TARGETS){return -1;}
+    ColorTarget target;
+    target.name = name;
+    target.range = range;
+    targets.push_back(target);
+    buildTable();
+    return (int)targets.size() - 1;
+}
+
+void ColorClassifier::buildTable(){
+    const int shift = 8 - bits;
+    const int levels = 1 << bits;
+    const int center = shift > 0 ? 1 << (shift - 1) : 0;
+
+    // one row of cell center colors per (b, g) pair, thresholded with the same kernel as the single target path
+    std::vector<uchar> colors(3*levels), mask(levels);
+    lut.assign((size_t)1 << (3*bits), 0);
+    for (int b = 0; b < levels; b++){
+        for (int g = 0; g < levels; g++){
+            for (int r = 0; r < levels; r++){
+                colors[3*r] = (uchar)((b << shift) + center);
+                colors[3*r + 1] = (uchar)((g << shift) + center);
+                colors[3*r + 2] = (uchar)((r << shift) + center);
+            }
+            uchar *cells = &lut[((size_t)b << (2*bits)) | ((size_t)g << bits)];
+            for (size_t t = 0; t < targets.size(); t++){
+                hsvThresholdRow(&colors[0], &mask[0], levels, targets[t].range);
+                for (int r = 0; r < levels; r++){
+                    if (mask[r]){cells[r] |= (uchar)(1 << t);}
+                }
+            }
+        }
+    }
+}
+
+void ColorClassifier::classify(const cv::Mat &bgr, std::vector<cv::Mat> &masks) const {
+    CV_Assert(bgr.type() == CV_8UC3);
+    const int numTargets = (int)targets.size();
+    const int shift = 8 - bits;
+    masks.resize(numTargets);
+    for (int t = 0; t < numTargets; t++){
+        masks[t].create(bgr.rows, bgr.cols, CV_8UC1);
+    }
+
+    const uchar *table = &lut[0];
+    uchar *out[MAX_TARGETS];
+    for (int y = 0; y < bgr.rows; y++){
+        const uchar *p = bgr.ptr<uchar>(y);
+        for (int t = 0; t < numTargets; t++){out[t] = masks[t].ptr<uchar>(y);}
+        for (int x = 0; x < bgr.cols; x++, p += 3){
+            unsigned cell = table[((unsigned)(p[0] >> shift) << (2*bits)) | ((unsigned)(p[1] >> shift) << bits) | (unsigned)(p[2] >> shift)];
+            for (int t = 0; t < numTargets; t++){
+                out[t][x] = (uchar)(0 - ((cell >> t) & 1));
+            }
+        }
+    }
+}
+
+void detectTargets(const ColorClassifier &classifier, const cv::Mat &bgr, bool useMorphOps,
+                   std::vector<cv::Mat> &masks, std::vector<Detection> &detections){
+    classifier.classify(bgr, masks);
+    detections.resize(masks.size());
+    for (size_t t = 0; t < masks.size(); t++){
+        if (useMorphOps){morphOps(masks[t]);}
+        detections[t] = findFilteredObject(masks[t]);
+    }
+}
@@ -0,0 +1,64 @@
+/***************************************
+ Multi-target color classification through a precomputed lookup table.
+
+ Up to MAX_TARGETS targets (gates, checkpoints) are registered, each with its
+ own HSV bounds. A table indexed by quantized BGR stores, for every color
+ cell, a bitmask of the targets whose bounds contain the cell's center color.
+ Classifying a frame is then one table lookup per pixel, whatever the number
+ of targets, and writes one binary mask per target.
+
+ With the default 6 bits per channel the table holds 2^18 entries (256 KB):
+ 64 levels per channel, each cell 4 values wide. 8 bits gives an exact, but
+ 16 MB, table.
+ ************************************/
+
+#ifndef COLOR_CLASSIFIER_H
+#define COLOR_CLASSIFIER_H
+
+#include <opencv2/opencv.hpp>
+#include <string>
+#include <vector>
+#include "hsvThreshold.h"
+
+//targets per classifier, one bit each in the table
+const int MAX_TARGETS = 8;
+
+struct ColorTarget {
+    std::string name;
+    HSVRange range;
+};
+
+class ColorClassifier {
+public:
+    explicit ColorClassifier(int quantizationBits = 6);
+    /// Restore a classifier from its targets and a copy of its table(), without rebuilding the table.
+    /// table must hold 2^(3*quantizationBits) entries built for these targets.
+    ColorClassifier(int quantizationBits, const std::vector<ColorTarget> &targets, const uchar *table);
+
+    /// Register a target and rebuild the table. Returns its id (0..MAX_TARGETS-1), or -1 when full.
+    int addTarget(const std::string &name, const HSVRange &range);
+    int numTargets() const {return (int)targets.size();}
+    const ColorTarget &target(int id) const {return targets[id];}
+    int quantizationBits() const {return bits;}
+
+    /// Write one CV_8UC1 mask per target (255 where the pixel's color belongs to the target) in a single pass over bgr.
+    void classify(const cv::Mat &bgr, std::vector<cv::Mat> &masks) const;
+
+    /// Target bitmask for every quantized color, index = (b >> s) << 2*bits | (g >> s) << bits | (r >> s), s = 8 - bits.
+    const std::vector<uchar> &table() const {return lut;}
+
+private:
+    void buildTable();
+
+    int bits;
+    std::vector<ColorTarget> targets;
+    std::vector<uchar> lut;
+};
+
+struct Detection;
+
+/// Classify bgr once, then clean up and search every target's mask. detections[id] belongs to target id.
+void detectTargets(const ColorClassifier &classifier, const cv::Mat &bgr, bool useMorphOps,
+                   std::vector<cv::Mat> &masks, std::vector<Detection> &detections);
+
+#endif
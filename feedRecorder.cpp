@@ -0,0 +1,215 @@
+#include "feedRecorder.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+
+static int fourcc(char c1, char c2, char c3, char c4){
+    // same as CV_FOURCC, which moved between headers across OpenCV versions
+    return (c1 & 255) + ((c2 & 255) << 8) + ((c3 & 255) << 16) + ((c4 & 255) << 24);
+}
+
+FeedRecorder::FeedRecorder(const RecorderOptions &options)
+: settings(options), slots(std::max(1, options.queueFrames)), freeSlots(slots.size()), queuedSlots(slots.size()),
+  running(false), lastSubmitted(-1), replayBytes(0), numPending(0), clipsDone(false),
+  submittedCount(0), droppedCount(0), recordedCount(0), clipsWrittenCount(0), clipsFailedCount(0),
+  replayFrameCount(0), replayMegabyteCount(0), replaySpan(0) {
+    for (size_t i = 0; i < slots.size(); i++){
+        slots[i].ready = false;
+        freeSlots.push(&slots[i]);
+    }
+    jpegParams.push_back(cv::IMWRITE_JPEG_QUALITY);
+    jpegParams.push_back(settings.replayJpegQuality);
+}
+
+FeedRecorder::~FeedRecorder(){
+    stop();
+}
+
+bool FeedRecorder::start(cv::Size frameSize){
+    if (running){return true;}
+    size = frameSize;
+    if (!settings.recordFile.empty() &&
+        !writer.open(settings.recordFile, fourcc('M','J','P','G'), settings.fps, frameSize, true)){
+        return false;
+    }
+    //the frame copies are made here, not on the first frames the workers submit
+    for (size_t i = 0; i < slots.size(); i++){slots[i].frame.create(frameSize, CV_8UC3);}
+    running = true;
+    clipsDone = false;
+    encoderThread = std::thread(&FeedRecorder::encoderLoop, this);
+    clipThread = std::thread(&FeedRecorder::clipLoop, this);
+    return true;
+}
+
+void FeedRecorder::stop(){
+    if (!running){return;}
+    running = false;
+    encoderThread.join();
+    {
+        std::lock_guard<std::mutex> lock(clipMutex);
+        clipsDone = true;
+    }
+    clipReady.notify_one();
+    clipThread.join();
+    writer.release();
+}
+
+bool FeedRecorder::submit(const cv::Mat &frame, long frameIndex, double captureTime){
+    if (!running){return false;}
+    submittedCount++;
+    //the order check and the queue position are taken together, so the encoder sees the slots in frame order
+    Slot *slot;
+    {
+        std::lock_guard<std::mutex> lock(submitMutex);
+        if (frameIndex <= lastSubmitted || !freeSlots.pop(slot)){
+            droppedCount++;
+            return false;
+        }
+        lastSubmitted = frameIndex;
+        queuedSlots.push(slot); // never full, it can hold every slot
+    }
+    frame.copyTo(slot->frame);
+    slot->frameIndex = frameIndex;
+    slot->captureTime = captureTime;
+    slot->ready.store(true, std::memory_order_release);
+    return true;
+}
+
+void FeedRecorder::requestReplay(long frameIndex, double captureTime, int lap, int checkpoint){
+    if (settings.replaySeconds <= 0){return;}
+    std::lock_guard<std::mutex> lock(pendingMutex);
+    if (numPending == MAX_PENDING_REPLAYS){
+        clipsFailedCount++;
+        return;
+    }
+    ReplayRequest &request = pending[numPending++];
+    request.eventTime = captureTime;
+    request.eventFrame = frameIndex;
+    request.lap = lap;
+    request.checkpoint = checkpoint;
+}
+
+RecorderStats FeedRecorder::stats() const {
+    RecorderStats s;
+    s.submitted = submittedCount;
+    s.dropped = droppedCount;
+    s.recorded = recordedCount;
+    s.replayFrames = replayFrameCount;
+    s.replayMegabytes = replayMegabyteCount;
+    s.replaySeconds = replaySpan;
+    s.clipsWritten = clipsWrittenCount;
+    s.clipsFailed = clipsFailedCount;
+    return s;
+}
+
+void FeedRecorder::encoderLoop(){
+    Slot *slot;
+    double latestTime = 0;
+    for (;;){
+        if (!queuedSlots.pop(slot)){
+            if (!running){break;}
+            std::this_thread::sleep_for(std::chrono::milliseconds(1));
+            continue;
+        }
+        //the slot is queued before its frame is copied in, the copy is on its way
+        while (!slot->ready.load(std::memory_order_acquire)){std::this_thread::yield();}
+        encode(*slot);
+        latestTime = slot->captureTime;
+        slot->ready.store(false, std::memory_order_relaxed);
+        freeSlots.push(slot);
+        servicePendingReplays(latestTime, false);
+    }
+    //the feed ended: events still waiting for their post-roll get what there is
+    servicePendingReplays(latestTime, true);
+}
+
+void FeedRecorder::encode(Slot &slot){
+    if (writer.isOpened()){
+        writer.write(slot.frame);
+        recordedCount++;
+    }
+    if (settings.replaySeconds <= 0){return;}
+
+    cv::imencode(".jpg", slot.frame, jpegBuffer, jpegParams);
+    ReplayFrame entry;
+    entry.jpeg = std::make_shared<const std::vector<uchar> >(jpegBuffer);
+    entry.captureTime = slot.captureTime;
+    replay.push_back(entry);
+    replayBytes += jpegBuffer.size();
+
+    //keep replaySeconds of feed within the memory budget. clips that were already handed out keep their
+    //frames alive through the shared pointers until they are written.
+    size_t budget = (size_t)(settings.replayMegabytes*1024*1024);
+    while (replay.size() > 1 && (replayBytes > budget || slot.captureTime - replay.front().captureTime > settings.replaySeconds)){
+        replayBytes -= replay.front().jpeg->size();
+        replay.pop_front();
+    }
+    replayFrameCount = (long)replay.size();
+    replayMegabyteCount = replayBytes/(1024.0*1024.0);
+    replaySpan = replay.back().captureTime - replay.front().captureTime;
+}
+
+void FeedRecorder::servicePendingReplays(double latestCaptureTime, bool flush){
+    std::vector<Clip> ready;
+    {
+        std::lock_guard<std::mutex> lock(pendingMutex);
+        int kept = 0;
+        for (int i = 0; i < numPending; i++){
+            const ReplayRequest &request = pending[i];
+            if (!flush && latestCaptureTime < request.eventTime + settings.postRollSeconds){
+                pending[kept++] = request;
+                continue;
+            }
+            Clip clip;
+            char name[64];
+            if (request.checkpoint < 0){
+                snprintf(name, sizeof(name), "-%06ld-lap%d-manual.avi", request.eventFrame, request.lap);
+            }else{
+                snprintf(name, sizeof(name), "-%06ld-lap%d-gate%d.avi", request.eventFrame, request.lap, request.checkpoint + 1);
+            }
+            clip.file = settings.clipPrefix + name;
+            double from = request.eventTime - settings.replaySeconds + settings.postRollSeconds;
+            for (size_t f = 0; f < replay.size(); f++){
+                if (replay[f].captureTime >= from){clip.frames.push_back(replay[f]);}
+            }
+            ready.push_back(clip);
+        }
+        numPending = kept;
+    }
+    if (ready.empty()){return;}
+    {
+        //a slow disk must not let the clips waiting to be written grow without bound
+        std::lock_guard<std::mutex> lock(clipMutex);
+        for (size_t i = 0; i < ready.size(); i++){
+            if (clips.size() < (size_t)MAX_QUEUED_CLIPS){clips.push_back(ready[i]);}else{clipsFailedCount++;}
+        }
+    }
+    clipReady.notify_one();
+}
+
+void FeedRecorder::clipLoop(){
+    for (;;){
+        Clip clip;
+        {
+            std::unique_lock<std::mutex> lock(clipMutex);
+            clipReady.wait(lock, [this]{return !clips.empty() || clipsDone;});
+            if (clips.empty()){return;}
+            clip = clips.front();
+            clips.pop_front();
+        }
+        if (writeClip(clip)){clipsWrittenCount++;}else{clipsFailedCount++;}
+    }
+}
+
+bool FeedRecorder::writeClip(const Clip &clip){
+    if (clip.frames.empty()){return false;}
+    cv::VideoWriter clipWriter;
+    if (!clipWriter.open(clip.file, fourcc('M','J','P','G'), settings.fps, size, true)){return false;}
+    cv::Mat frame;
+    for (size_t i = 0; i < clip.frames.size(); i++){
+        frame = cv::imdecode(*clip.frames[i].jpeg, cv::IMREAD_COLOR);
+        if (!frame.empty()){clipWriter.write(frame);}
+    }
+    return true;
+}
@@ -0,0 +1,146 @@
+/***************************************
+ Background recording and instant replay of the annotated feed.
+
+ Detection workers hand each finished frame to submit(), which copies it
+ into one of a fixed number of preallocated slots and returns. If every
+ slot is still waiting for the encoder the frame is dropped and counted,
+ so a slow disk or encoder never holds up tracking.
+
+ The encoder thread writes the frames to the recording file, and JPEG
+ compresses them into a replay ring holding the last replaySeconds of
+ feed within a fixed memory budget. requestReplay() (called for every lap
+ and checkpoint crossing) marks an event. Once postRollSeconds of feed
+ after it have arrived, the ring is snapshotted and a clip thread writes it
+ to its own file, so clip writing does not hold up the encoder either.
+
+ Memory use is bounded by queueFrames frame copies plus replayMegabytes of
+ JPEG data in the ring. Clips waiting for the clip thread keep their frames
+ alive after the ring let go of them, so at most MAX_QUEUED_CLIPS clips
+ wait. Further clips are dropped and counted as failed until the clip
+ thread catches up.
+ ************************************/
+
+#ifndef FEED_RECORDER_H
+#define FEED_RECORDER_H
+
+#include <atomic>
+#include <condition_variable>
+#include <deque>
+#include <memory>
+#include <mutex>
+#include <opencv2/opencv.hpp>
+#include <string>
+#include <thread>
+#include <vector>
+#include "frameQueue.h"
+
+struct RecorderOptions {
+    std::string recordFile;   // continuous recording of every frame that made it to the encoder, empty for none
+    double fps;               // frame rate written into the recording and the clips
+    int queueFrames;          // frames that may wait for the encoder before new ones are dropped
+    double replaySeconds;     // length of the replay ring, 0 turns instant replay off
+    double replayMegabytes;   // memory budget of the replay ring, the oldest frames go first when it is full
+    int replayJpegQuality;    // JPEG quality of the frames in the ring
+    double postRollSeconds;   // feed after the event that goes into a clip
+    std::string clipPrefix;   // clips are written to <clipPrefix>-<frame>-lap<N>-gate<M>.avi (or -manual.avi)
+    RecorderOptions(): fps(30), queueFrames(8), replaySeconds(10), replayMegabytes(256), replayJpegQuality(80),
+                       postRollSeconds(1), clipPrefix("replay") {}
+};
+
+struct RecorderStats {
+    long submitted;      // frames handed to submit()
+    long dropped;        // frames dropped because the encoder was behind, or because a newer frame was submitted first
+    long recorded;       // frames written to the recording file
+    long replayFrames;   // frames in the replay ring now
+    double replayMegabytes;
+    double replaySeconds; // span of the replay ring now
+    long clipsWritten;
+    long clipsFailed;    // clips that could not be written, or were dropped because too many were waiting
+};
+
+class FeedRecorder {
+public:
+    explicit FeedRecorder(const RecorderOptions &options);
+    ~FeedRecorder();
+
+    /// Start the encoder and clip threads. False if the recording file could not be opened.
+    bool start(cv::Size frameSize);
+    /// Write out what is queued and pending, then stop both threads.
+    void stop();
+    bool isRunning() const {return running;}
+
+    /// Queue an annotated frame. Returns false if the frame was dropped because the encoder is behind.
+    /// Frames older than the last one submitted are dropped too, so the recording does not jump back when
+    /// several workers submit. Waits only while another worker claims a slot, the copy is made outside the lock.
+    bool submit(const cv::Mat &frame, long frameIndex, double captureTime);
+    /// Save a clip of the replay ring around an event in frame frameIndex: a crossing of checkpoint (0 = start/finish)
+    /// in lap, or a clip asked for by hand when checkpoint is -1. Does not allocate.
+    void requestReplay(long frameIndex, double captureTime, int lap, int checkpoint);
+
+    RecorderStats stats() const;
+    const RecorderOptions &options() const {return settings;}
+
+private:
+    FeedRecorder(const FeedRecorder &);
+    FeedRecorder &operator=(const FeedRecorder &);
+
+    struct Slot {
+        cv::Mat frame;
+        long frameIndex;
+        double captureTime;
+        std::atomic<bool> ready; // the frame has been copied in, the encoder may read it
+    };
+    struct ReplayFrame {
+        std::shared_ptr<const std::vector<uchar> > jpeg;
+        double captureTime;
+    };
+    struct ReplayRequest {
+        double eventTime;
+        long eventFrame;
+        int lap, checkpoint;
+    };
+    struct Clip {
+        std::string file;
+        std::vector<ReplayFrame> frames;
+    };
+    static const int MAX_PENDING_REPLAYS = 8;
+    static const int MAX_QUEUED_CLIPS = 4; // each holds up to replayMegabytes of JPEG data
+
+    void encoderLoop();
+    void clipLoop();
+    void encode(Slot &slot);
+    void servicePendingReplays(double latestCaptureTime, bool flush);
+    bool writeClip(const Clip &clip);
+
+    RecorderOptions settings;
+    std::vector<Slot> slots;
+    FrameQueue<Slot*> freeSlots;
+    FrameQueue<Slot*> queuedSlots;
+    std::atomic<bool> running;
+    std::mutex submitMutex; // slots are queued in frame order, the frames are copied in afterwards
+    long lastSubmitted;
+    std::thread encoderThread;
+    cv::VideoWriter writer;
+
+    std::deque<ReplayFrame> replay; // encoder thread only
+    size_t replayBytes;
+    std::vector<uchar> jpegBuffer;
+    std::vector<int> jpegParams;
+
+    std::mutex pendingMutex;
+    ReplayRequest pending[MAX_PENDING_REPLAYS];
+    int numPending;
+
+    std::mutex clipMutex;
+    std::condition_variable clipReady;
+    std::deque<Clip> clips;
+    bool clipsDone;
+    std::thread clipThread;
+
+    std::atomic<long> submittedCount, droppedCount, recordedCount, clipsWrittenCount, clipsFailedCount;
+    std::atomic<long> replayFrameCount;
+    std::atomic<double> replayMegabyteCount, replaySpan;
+    cv::Size size;
+};
+
+#endif
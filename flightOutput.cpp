@@ -0,0 +1,205 @@
+#include "flightOutput.h"
+#include "latencyStats.h"
+
+#include <algorithm>
+#include <cstring>
+#include <new>
+
+#ifndef _WIN32
+#include <arpa/inet.h>
+#include <fcntl.h>
+#include <netinet/in.h>
+#include <sys/mman.h>
+#include <sys/socket.h>
+#include <unistd.h>
+#endif
+
+//a reader gives up after this many attempts that overlapped an update. an update takes well under a microsecond.
+const int READ_RETRIES = 1000;
+
+ControlSample controlSample(const Detection &detection, long frameIndex, double captureTime, cv::Size frameSize){
+    ControlSample sample;
+    memset(&sample, 0, sizeof(sample));
+    sample.frameIndex = (uint64_t)frameIndex;
+    sample.captureTime = captureTime;
+    sample.frameWidth = (uint16_t)frameSize.width;
+    sample.frameHeight = (uint16_t)frameSize.height;
+    sample.tooNoisy = detection.tooNoisy;
+    sample.found = detection.found;
+    if (!detection.found || frameSize.area() == 0){return sample;}
+
+    float halfWidth = 0.5f*frameSize.width, halfHeight = 0.5f*frameSize.height;
+    sample.errorX = std::max(-1.f, std::min(1.f, (detection.x - halfWidth)/halfWidth));
+    sample.errorY = std::max(-1.f, std::min(1.f, (detection.y - halfHeight)/halfHeight));
+    sample.area = (float)(detection.area/frameSize.area());
+    sample.x = detection.x;
+    sample.y = detection.y;
+    sample.yaw = (int8_t)detection.yaw;
+    sample.pitch = (int8_t)detection.pitch;
+    //a solid object fills most of its box, and a clean filter leaves few other blobs
+    double fill = detection.boundingBox.area() > 0 ? std::min(1.0, detection.area/detection.boundingBox.area()) : 0;
+    double competition = 1.0 - (double)std::max(0, detection.numObjects - 1)/MAX_NUM_OBJECTS;
+    sample.confidence = (float)(fill*competition);
+    return sample;
+}
+
+static void initControlBlock(ControlBlock &block){
+    block.sequence.store(0, std::memory_order_relaxed);
+    for (int i = 0; i < CONTROL_SAMPLE_WORDS; i++){block.words[i].store(0, std::memory_order_relaxed);}
+    block.version = FLIGHT_OUTPUT_VERSION;
+    std::atomic_thread_fence(std::memory_order_release);
+    block.magic = FLIGHT_OUTPUT_MAGIC;
+}
+
+bool readControlBlock(const ControlBlock &block, ControlSample &sample, uint64_t &sequence){
+    uint64_t words[CONTROL_SAMPLE_WORDS];
+    for (int attempt = 0; attempt < READ_RETRIES; attempt++){
+        uint64_t before = block.sequence.load(std::memory_order_acquire);
+        if (before == 0){return false;}
+        if (before & 1){continue;} // the writer is in the middle of an update
+        for (int i = 0; i < CONTROL_SAMPLE_WORDS; i++){words[i] = block.words[i].load(std::memory_order_relaxed);}
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if (block.sequence.load(std::memory_order_relaxed) == before){
+            memcpy(&sample, words, sizeof(sample));
+            sequence = before/2 - 1;
+            return true;
+        }
+    }
+    return false;
+}
+
+FlightOutput::FlightOutput(): block(&localBlock), udpSocket(-1), count(0) {
+    initControlBlock(localBlock);
+}
+
+FlightOutput::~FlightOutput(){
+    close();
+}
+
+bool FlightOutput::openSharedMemory(const std::string &name){
+#ifdef _WIN32
+    (void)name;
+    return false;
+#else
+    int fd = shm_open(name.c_str(), O_CREAT | O_RDWR, 0644);
+    if (fd < 0){return false;}
+    bool sized = ftruncate(fd, sizeof(ControlBlock)) == 0;
+    void *memory = sized ? mmap(0, sizeof(ControlBlock), PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0) : MAP_FAILED;
+    ::close(fd);
+    if (memory == MAP_FAILED){
+        shm_unlink(name.c_str());
+        return false;
+    }
+    if (block != &localBlock){munmap(block, sizeof(ControlBlock));}
+    block = new (memory) ControlBlock;
+    initControlBlock(*block);
+    shmName = name;
+    return true;
+#endif
+}
+
+bool FlightOutput::openUdp(const std::string &host, int port){
+#ifdef _WIN32
+    (void)host; (void)port;
+    return false;
+#else
+    sockaddr_in address;
+    memset(&address, 0, sizeof(address));
+    address.sin_family = AF_INET;
+    address.sin_port = htons((uint16_t)port);
+    if (port <= 0 || port > 65535 || inet_pton(AF_INET, host.c_str(), &address.sin_addr) != 1){return false;}
+    int fd = socket(AF_INET, SOCK_DGRAM, 0);
+    if (fd < 0){return false;}
+    //a slow or missing receiver must never hold up the tracker
+    fcntl(fd, F_SETFL, fcntl(fd, F_GETFL, 0) | O_NONBLOCK);
+    if (udpSocket >= 0){::close(udpSocket);}
+    udpSocket = fd;
+    udpAddress.assign((const uchar*)&address, (const uchar*)&address + sizeof(address));
+    return true;
+#endif
+}
+
+void FlightOutput::close(){
+#ifndef _WIN32
+    if (udpSocket >= 0){::close(udpSocket);}
+    if (block != &localBlock){
+        munmap(block, sizeof(ControlBlock));
+        shm_unlink(shmName.c_str());
+    }
+#endif
+    udpSocket = -1;
+    block = &localBlock;
+    shmName.clear();
+}
+
+void FlightOutput::publish(ControlSample sample){
+    sample.publishTime = latencyClock();
+    uint64_t words[CONTROL_SAMPLE_WORDS];
+    memcpy(words, &sample, sizeof(sample));
+
+    //seqlock write: odd sequence, payload, even sequence. the release fence keeps the payload stores
+    //from being seen before the odd sequence number.
+    uint64_t published = count.load(std::memory_order_relaxed);
+    uint64_t sequence = 2*published;
+    block->sequence.store(sequence + 1, std::memory_order_relaxed);
+    std::atomic_thread_fence(std::memory_order_release);
+    for (int i = 0; i < CONTROL_SAMPLE_WORDS; i++){block->words[i].store(words[i], std::memory_order_relaxed);}
+    block->sequence.store(sequence + 2, std::memory_order_release);
+
+#ifndef _WIN32
+    if (udpSocket >= 0){
+        ControlDatagram datagram;
+        datagram.magic = FLIGHT_OUTPUT_MAGIC;
+        datagram.version = FLIGHT_OUTPUT_VERSION;
+        datagram.sequence = published;
+        datagram.sample = sample;
+        //a full socket buffer drops the datagram, the next one supersedes it anyway
+        sendto(udpSocket, &datagram, sizeof(datagram), 0, (const sockaddr*)&udpAddress[0], (socklen_t)udpAddress.size());
+    }
+#endif
+    count.store(published + 1, std::memory_order_relaxed);
+}
+
+bool FlightOutput::latest(ControlSample &sample) const {
+    uint64_t sequence;
+    return readControlBlock(*block, sample, sequence);
+}
+
+FlightOutputReader::FlightOutputReader(): block(0) {}
+
+FlightOutputReader::~FlightOutputReader(){
+    close();
+}
+
+bool FlightOutputReader::open(const std::string &name){
+    close();
+#ifdef _WIN32
+    (void)name;
+    return false;
+#else
+    int fd = shm_open(name.c_str(), O_RDONLY, 0);
+    if (fd < 0){return false;}
+    void *memory = mmap(0, sizeof(ControlBlock), PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if (memory == MAP_FAILED){return false;}
+    const ControlBlock *mapped = (const ControlBlock*)memory;
+    if (mapped->magic != FLIGHT_OUTPUT_MAGIC || mapped->version != FLIGHT_OUTPUT_VERSION){
+        munmap(memory, sizeof(ControlBlock));
+        return false;
+    }
+    std::atomic_thread_fence(std::memory_order_acquire);
+    block = mapped;
+    return true;
+#endif
+}
+
+void FlightOutputReader::close(){
+#ifndef _WIN32
+    if (block){munmap((void*)block, sizeof(ControlBlock));}
+#endif
+    block = 0;
+}
+
+bool FlightOutputReader::read(ControlSample &sample, uint64_t &sequence) const {
+    return block && readControlBlock(*block, sample, sequence);
+}
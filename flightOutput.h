@@ -0,0 +1,130 @@
+/***************************************
+ Output channel from the tracker to the flight controller.
+
+ Every tracked frame is published as a ControlSample: capture and publish
+ timestamps, the continuous offset of the object from the frame centre,
+ its area, a confidence and the found flag. The latest sample sits in a
+ seqlock in POSIX shared memory. The tracker is the only writer, so
+ publishing is two counter stores around the payload with no locks and no
+ system calls. Readers in other processes poll the sequence counter and
+ retry when it changed under them, so they never see a torn sample.
+ Optionally every sample is also sent as one UDP datagram to a local port.
+
+ Timestamps are on latencyClock(), a monotonic clock every process on the
+ machine shares, so a reader can measure its own handoff latency.
+ ************************************/
+
+#ifndef FLIGHT_OUTPUT_H
+#define FLIGHT_OUTPUT_H
+
+#include <atomic>
+#include <opencv2/opencv.hpp>
+#include <stdint.h>
+#include <string>
+#include <vector>
+#include "objectTracking.h"
+
+//shared memory object the tracker publishes to unless another name is given
+const std::string DEFAULT_FLIGHT_OUTPUT_NAME = "/quadracing-control";
+//first bytes of the shared memory block and of every datagram, and the layout version
+const uint32_t FLIGHT_OUTPUT_MAGIC = 0x51524354; // "QRCT"
+const uint32_t FLIGHT_OUTPUT_VERSION = 1;
+
+/// One detection result as the flight controller sees it. Fixed layout, host byte order.
+struct ControlSample {
+    uint64_t frameIndex;
+    double captureTime;     // latencyClock() seconds when the frame was read from the camera
+    double publishTime;     // latencyClock() seconds when the sample was published
+    float errorX, errorY;   // centroid offset from the frame centre, -1 (left/top) to 1 (right/bottom), 0 when not found
+    float area;             // object area as a fraction of the frame
+    float confidence;       // 0..1, see controlSample()
+    int32_t x, y;           // centroid in pixels
+    uint16_t frameWidth, frameHeight;
+    uint8_t found;
+    uint8_t tooNoisy;
+    int8_t yaw, pitch;      // the old -1/0/1 directions with 100 px dead zones
+};
+
+const int CONTROL_SAMPLE_WORDS = sizeof(ControlSample)/sizeof(uint64_t);
+static_assert(sizeof(ControlSample) % sizeof(uint64_t) == 0, "ControlSample is copied as whole 64-bit words");
+
+/// Datagram sent for every sample when UDP output is on.
+struct ControlDatagram {
+    uint32_t magic;
+    uint32_t version;
+    uint64_t sequence;      // number of samples published before this one
+    ControlSample sample;
+};
+
+/// Sample for a detection in a frame of the given size. The confidence is the fraction of the object's bounding
+/// box it fills, lowered when other blobs compete with it, and 0 when nothing was found.
+ControlSample controlSample(const Detection &detection, long frameIndex, double captureTime, cv::Size frameSize);
+
+/// Seqlock block, laid out the same in every process that maps it.
+struct ControlBlock {
+    uint32_t magic;
+    uint32_t version;
+    std::atomic<uint64_t> sequence;             // odd while the writer is in the middle of an update
+    std::atomic<uint64_t> words[CONTROL_SAMPLE_WORDS]; // the sample, copied word by word
+};
+
+/// Writing end. Only one thread may publish at a time.
+class FlightOutput {
+public:
+    FlightOutput();
+    ~FlightOutput();
+
+    /// Create (or take over) the shared memory object name and publish into it. False if that failed,
+    /// publishing then only updates latest().
+    bool openSharedMemory(const std::string &name = DEFAULT_FLIGHT_OUTPUT_NAME);
+    /// Also send every sample to host:port. False if the socket could not be set up.
+    bool openUdp(const std::string &host, int port);
+    void close();
+
+    /// Stamp the publish time and hand the sample over.
+    void publish(ControlSample sample);
+    /// Last published sample, for readers in this process.
+    bool latest(ControlSample &sample) const;
+    /// Samples published so far. Safe to call from any thread.
+    uint64_t publishedCount() const {return count.load(std::memory_order_relaxed);}
+
+private:
+    FlightOutput(const FlightOutput &);
+    FlightOutput &operator=(const FlightOutput &);
+
+    ControlBlock localBlock; // used until shared memory is opened
+    ControlBlock *block;
+    std::string shmName;
+    int udpSocket;
+    std::vector<uchar> udpAddress; // sockaddr_in, kept opaque so this header needs no socket headers
+    std::atomic<uint64_t> count; // written by the publisher only, read by the reports
+};
+
+/// Reading end of the shared memory channel, for the flight controller or a test.
+class FlightOutputReader {
+public:
+    FlightOutputReader();
+    ~FlightOutputReader();
+
+    /// Map the shared memory object a FlightOutput publishes to. False if it does not exist (yet) or is
+    /// from another version.
+    bool open(const std::string &name = DEFAULT_FLIGHT_OUTPUT_NAME);
+    void close();
+    bool isOpen() const {return block != 0;}
+
+    /// Copy out the latest sample. Returns false if nothing was published yet or the writer kept
+    /// overwriting the sample for the whole retry budget. sequence receives the number of samples
+    /// published before it, so a gap between two reads counts the samples the reader missed.
+    bool read(ControlSample &sample, uint64_t &sequence) const;
+
+private:
+    FlightOutputReader(const FlightOutputReader &);
+    FlightOutputReader &operator=(const FlightOutputReader &);
+
+    const ControlBlock *block;
+};
+
+/// Seqlock read of a block, shared by FlightOutput::latest() and FlightOutputReader.
+bool readControlBlock(const ControlBlock &block, ControlSample &sample, uint64_t &sequence);
+
+#endif
@@ -0,0 +1,72 @@
+/***************************************
+ Preallocated frames for the tracking pipeline.
+
+ Every FramePacket the pipeline uses is created, with its image buffers,
+ when the pool is built. Packets then circulate as pointers: free list ->
+ capture -> detection -> display -> free list, and each stage writes into
+ the buffers already in the packet (cv::Mat::create reuses a buffer of the
+ right size and type), so once every packet has been around the loop a
+ frame no longer touches the heap.
+ ************************************/
+
+#ifndef FRAME_POOL_H
+#define FRAME_POOL_H
+
+#include <opencv2/opencv.hpp>
+#include <vector>
+#include "colorClassifier.h"
+#include "frameQueue.h"
+#include "histogram.h"
+#include "objectTracking.h"
+
+/// Frame handed between the capture, detection and display stages.
+struct FramePacket {
+    cv::Mat cameraFeed; // BGR frame. The detection stage draws its overlay on it.
+    cv::Mat HSV;        // only filled in when a debug window shows it
+    cv::Mat threshold;  // binary image after morphological operations
+    std::vector<cv::Mat> gateMasks;        // one binary image per registered gate target
+    std::vector<Detection> gateDetections; // one detection per registered gate target
+    ChannelHistogram bgrHistogram;         // counts of cameraFeed and HSV, only valid when hasHistograms is set
+    ChannelHistogram hsvHistogram;
+    bool hasHSV;
+    bool hasHistograms;
+    long frameIndex;
+    double captureTime; // seconds (cv::getTickCount based), taken right after the frame was read
+    FramePacket(): hasHSV(false), hasHistograms(false), frameIndex(-1), captureTime(0) {}
+};
+
+class FramePool {
+public:
+    /// size packets with buffers for frameSize frames.
+    FramePool(size_t size, cv::Size frameSize): packets(size), freeList(size){
+        for (size_t i = 0; i < packets.size(); i++){
+            FramePacket &packet = packets[i];
+            packet.cameraFeed.create(frameSize, CV_8UC3);
+            packet.HSV.create(frameSize, CV_8UC3);
+            packet.threshold.create(frameSize, CV_8UC1);
+            packet.gateMasks.reserve(MAX_TARGETS);
+            packet.gateDetections.reserve(MAX_TARGETS);
+            freeList.push(&packet);
+        }
+    }
+
+    /// A free packet, or 0 when every packet is in use.
+    FramePacket *acquire(){
+        FramePacket *packet = 0;
+        return freeList.pop(packet) ? packet : 0;
+    }
+    /// Give a packet back. Null is ignored.
+    void release(FramePacket *packet){
+        if (packet){freeList.push(packet);}
+    }
+    size_t size() const {return packets.size();}
+
+private:
+    FramePool(const FramePool &);
+    FramePool &operator=(const FramePool &);
+
+    std::vector<FramePacket> packets;
+    FrameQueue<FramePacket*> freeList; // never full, it can hold every packet
+};
+
+#endif
@@ -0,0 +1,127 @@
+/***************************************
+ Bounded lock-free ring buffer used to hand frames between pipeline stages.
+
+ Any number of threads may push and pop concurrently (each cell carries a
+ sequence number, so producers and consumers never take a lock). The
+ capacity is fixed at construction and rounded up to a power of two.
+
+ pushDropOldest() implements the drop-oldest policy used by the tracking
+ pipeline: when the ring is full the producer evicts the oldest entry so the
+ consumer always sees the freshest frame. The entries are usually pointers
+ into a FramePool, so the evicted ones can be handed back for reuse.
+ ************************************/
+
+#ifndef FRAME_QUEUE_H
+#define FRAME_QUEUE_H
+
+#include <atomic>
+#include <cstddef>
+
+template <typename T>
+class FrameQueue {
+public:
+    explicit FrameQueue(size_t capacity){
+        size_t size = 2;
+        while (size < capacity){size <<= 1;}
+        mask = size - 1;
+        cells = new Cell[size];
+        for (size_t i = 0; i < size; i++){
+            cells[i].sequence.store(i, std::memory_order_relaxed);
+        }
+        enqueuePos.store(0, std::memory_order_relaxed);
+        dequeuePos.store(0, std::memory_order_relaxed);
+    }
+    ~FrameQueue(){
+        delete[] cells;
+    }
+
+    /// Append item. Returns false if the ring is full.
+    bool push(const T &item){
+        Cell *cell;
+        size_t pos = enqueuePos.load(std::memory_order_relaxed);
+        for (;;){
+            cell = &cells[pos & mask];
+            size_t seq = cell->sequence.load(std::memory_order_acquire);
+            ptrdiff_t dif = (ptrdiff_t)seq - (ptrdiff_t)pos;
+            if (dif == 0){
+                if (enqueuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)){break;}
+            }else if (dif < 0){
+                return false;
+            }else{
+                pos = enqueuePos.load(std::memory_order_relaxed);
+            }
+        }
+        cell->data = item;
+        cell->sequence.store(pos + 1, std::memory_order_release);
+        return true;
+    }
+
+    /// Remove the oldest item. Returns false if the ring is empty.
+    bool pop(T &item){
+        Cell *cell;
+        size_t pos = dequeuePos.load(std::memory_order_relaxed);
+        for (;;){
+            cell = &cells[pos & mask];
+            size_t seq = cell->sequence.load(std::memory_order_acquire);
+            ptrdiff_t dif = (ptrdiff_t)seq - (ptrdiff_t)(pos + 1);
+            if (dif == 0){
+                if (dequeuePos.compare_exchange_weak(pos, pos + 1, std::memory_order_relaxed)){break;}
+            }else if (dif < 0){
+                return false;
+            }else{
+                pos = dequeuePos.load(std::memory_order_relaxed);
+            }
+        }
+        item = cell->data;
+        cell->data = T(); // do not keep the frame alive inside the ring
+        cell->sequence.store(pos + mask + 1, std::memory_order_release);
+        return true;
+    }
+
+    /// Append item, evicting the oldest entries while the ring is full. Returns how many entries were dropped.
+    int pushDropOldest(const T &item){
+        int dropped = 0;
+        while (!push(item)){
+            T oldest;
+            if (pop(oldest)){dropped++;}
+        }
+        return dropped;
+    }
+
+    /// Same as pushDropOldest(item), but every evicted entry is handed to recycle(entry) instead of being
+    /// destroyed, e.g. to return a pooled frame to its free list.
+    template <typename Recycle>
+    int pushDropOldest(const T &item, Recycle recycle){
+        int dropped = 0;
+        while (!push(item)){
+            T oldest;
+            if (pop(oldest)){
+                recycle(oldest);
+                dropped++;
+            }
+        }
+        return dropped;
+    }
+
+    size_t capacity() const {return mask + 1;}
+
+private:
+    struct Cell {
+        std::atomic<size_t> sequence;
+        T data;
+    };
+
+    FrameQueue(const FrameQueue &);
+    FrameQueue &operator=(const FrameQueue &);
+
+    Cell *cells;
+    size_t mask;
+    // keep producer and consumer positions on separate cache lines
+    char pad0[64];
+    std::atomic<size_t> enqueuePos;
+    char pad1[64];
+    std::atomic<size_t> dequeuePos;
+    char pad2[64];
+};
+
+#endif
@@ -0,0 +1,95 @@
+/***************************************
+ Puts per-frame results back into frame order.
+
+ Workers finish frames in any order, but some consumers (the race timing)
+ must see them in the order they were captured. Every frame number from the
+ first one on is either added with its item or skipped, when it was dropped
+ before it was processed. next() hands the items out in frame order as soon
+ as every earlier frame has been added or skipped, so nothing is thrown
+ away and no item waits longer than the slowest earlier frame.
+
+ Items wait in a ring indexed by frame number. The ring doubles when a frame
+ arrives further ahead than it can hold, so once it has grown to the
+ deepest reordering seen it no longer allocates. Not thread safe, callers
+ hold their own lock.
+ ************************************/
+
+#ifndef FRAME_SEQUENCER_H
+#define FRAME_SEQUENCER_H
+
+#include <cstddef>
+#include <vector>
+
+template <typename T>
+class FrameSequencer {
+public:
+    explicit FrameSequencer(size_t capacity = 16): first(0) {
+        size_t size = 2;
+        while (size < capacity){size <<= 1;}
+        slots.resize(size);
+    }
+
+    /// Drop every waiting item. Frames before firstFrame count as handed out.
+    void reset(long firstFrame){
+        for (size_t i = 0; i < slots.size(); i++){slots[i].state = EMPTY;}
+        first = firstFrame;
+    }
+    /// Hold item until every earlier frame is in. False if frame was already handed out, added or skipped.
+    bool add(long frame, const T &item){return put(frame, &item);}
+    /// frame will never be added, e.g. it was dropped before a worker got it.
+    bool skip(long frame){return put(frame, 0);}
+    /// The item of the next frame in order, once it has arrived. Skipped frames are passed over.
+    bool next(T &item){
+        for (;;){
+            Slot &slot = slots[(size_t)first & (slots.size() - 1)];
+            if (slot.state == EMPTY){return false;}
+            State state = slot.state;
+            slot.state = EMPTY;
+            first++;
+            if (state == READY){
+                item = slot.item;
+                return true;
+            }
+        }
+    }
+    /// First frame not handed out yet.
+    long nextFrame() const {return first;}
+    /// Frames added or skipped that wait for an earlier one.
+    size_t waiting() const {
+        size_t count = 0;
+        for (size_t i = 0; i < slots.size(); i++){count += slots[i].state != EMPTY;}
+        return count;
+    }
+
+private:
+    enum State {EMPTY, READY, SKIPPED};
+    struct Slot {
+        long frame;
+        State state;
+        T item;
+        Slot(): frame(0), state(EMPTY), item() {}
+    };
+
+    bool put(long frame, const T *item){
+        if (frame < first){return false;}
+        while (frame - first >= (long)slots.size()){grow();}
+        Slot &slot = slots[(size_t)frame & (slots.size() - 1)];
+        if (slot.state != EMPTY){return false;}
+        slot.frame = frame;
+        slot.state = item ? READY : SKIPPED;
+        if (item){slot.item = *item;}
+        return true;
+    }
+    void grow(){
+        std::vector<Slot> larger(2*slots.size());
+        for (size_t i = 0; i < slots.size(); i++){
+            if (slots[i].state != EMPTY){larger[(size_t)slots[i].frame & (larger.size() - 1)] = slots[i];}
+        }
+        slots.swap(larger);
+    }
+
+    std::vector<Slot> slots; // power of two, frame f waits in slot f & (size - 1)
+    long first;
+};
+
+#endif
@@ -0,0 +1,139 @@
+#include "histogram.h"
+#include "objectTracking.h"
+
+#include <algorithm>
+#include <cstring>
+
+int HSVMinMaxThreshold = 3; //horizontal line that, if the histogram rise above, set the minimum and maximum threshold values.
+bool lockHSVThreshold = false;//locks threshold values
+
+namespace {
+
+/// Smallest and largest count of one channel.
+void countRange(const int *counts, int &lowest, int &highest){
+    lowest = highest = counts[0];
+    for (int i = 1; i < HISTOGRAM_BINS; i++){
+        lowest = std::min(lowest, counts[i]);
+        highest = std::max(highest, counts[i]);
+    }
+}
+
+/// Bounds of one channel. A bin is above the line when its count, scaled to [0, HISTOGRAM_HEIGHT] the way
+/// the drawn histogram is, exceeds HSVMinMaxThreshold. Compared in integers, so no scaled copy is made.
+void channelBounds(const int *counts, int &minBound, int &maxBound){
+    int lowest, highest;
+    countRange(counts, lowest, highest);
+    long long span = (long long)(highest - lowest)*HSVMinMaxThreshold;
+    int first = -1, last = -1;
+    for (int i = 1; i < HISTOGRAM_BINS; i++){
+        if ((long long)(counts[i] - lowest)*HISTOGRAM_HEIGHT > span){
+            if (first < 0){first = i;}
+            last = i;
+        }
+    }
+    if (first < 0){return;}
+    minBound = first - HISTOGRAM_MARGIN;
+    maxBound = last + HISTOGRAM_MARGIN;
+}
+
+} // namespace
+
+void computeHistogram(const cv::Mat &img, ChannelHistogram &hist, int step){
+    CV_Assert(img.type() == CV_8UC3);
+    step = std::max(1, step);
+    // two banks per channel, so neighbouring pixels with the same value do not wait on each other's increment
+    static thread_local int banks[2][3][HISTOGRAM_BINS];
+    memset(banks, 0, sizeof(banks));
+
+    int rows = img.rows, cols = img.cols;
+    if (step == 1 && img.isContinuous()){
+        cols *= rows;
+        rows = 1;
+    }
+    int samples = 0;
+    for (int y = 0; y < rows; y += step){
+        const uchar *p = img.ptr<uchar>(y);
+        int x = 0;
+        if (step == 1){
+            for (; x + 2 <= cols; x += 2, p += 6){
+                banks[0][0][p[0]]++; banks[0][1][p[1]]++; banks[0][2][p[2]]++;
+                banks[1][0][p[3]]++; banks[1][1][p[4]]++; banks[1][2][p[5]]++;
+            }
+        }
+        for (; x < cols; x += step, p += 3*step){
+            banks[0][0][p[0]]++; banks[0][1][p[1]]++; banks[0][2][p[2]]++;
+        }
+        samples += (cols + step - 1)/step;
+    }
+
+    for (int c = 0; c < 3; c++){
+        for (int i = 0; i < HISTOGRAM_BINS; i++){hist.counts[c][i] = banks[0][c][i] + banks[1][c][i];}
+    }
+    hist.samples = samples;
+}
+
+void boundsFromHistogram(const ChannelHistogram &hist, HSVRange &range){
+    channelBounds(hist.counts[0], range.hMin, range.hMax);
+    channelBounds(hist.counts[1], range.sMin, range.sMax);
+    channelBounds(hist.counts[2], range.vMin, range.vMax);
+}
+
+void updateThresholdsFromHistogram(const ChannelHistogram &hist){
+    if (lockHSVThreshold){return;}
+    HSVRange range = currentHSVRange();
+    boundsFromHistogram(hist, range);
+    H_MIN = range.hMin; H_MAX = range.hMax;
+    S_MIN = range.sMin; S_MAX = range.sMax;
+    V_MIN = range.vMin; V_MAX = range.vMax;
+}
+
+void renderHistogram(const ChannelHistogram &hist, bool displayHSVThresholdLines, cv::Mat &histImage){
+// Originally by E. Schnipke Feb. 5th, 2014
+    /// Draw the histograms for H, S, and V
+    int hist_w = HISTOGRAM_WIDTH; int hist_h = HISTOGRAM_HEIGHT;
+    int bin_w = cvRound( (double) hist_w/HISTOGRAM_BINS );
+    const cv::Scalar channelColor[3] = { cv::Scalar( 255, 0, 0), cv::Scalar( 0, 255, 0), cv::Scalar( 0, 0, 255) };
+    const cv::Scalar boundColor[3] = { cv::Scalar( 255, 200, 200), cv::Scalar( 200, 255, 200), cv::Scalar( 200, 200, 255) };
+
+    histImage.create( hist_h, hist_w, CV_8UC3 );
+    histImage.setTo( cv::Scalar( 0,0,0) );
+
+    /// Draw histogram for each channel, normalized to [ 0, histImage.rows ]
+    for (int c = 0; c < 3; c++){
+        const int *counts = hist.counts[c];
+        int lowest, highest;
+        countRange(counts, lowest, highest);
+        double scale = highest > lowest ? (double)hist_h/(highest - lowest) : 0;
+        cv::Point previous( 0, hist_h - cvRound((counts[0] - lowest)*scale) );
+        for(int i = 1; i < HISTOGRAM_BINS; i++){
+            cv::Point current( bin_w*i, hist_h - cvRound((counts[i] - lowest)*scale) );
+            line( histImage, previous, current, channelColor[c], 2, 8, 0 );
+            previous = current;
+        }
+    }
+
+    /// Plot threshold lines on histogram
+    if (displayHSVThresholdLines){
+        HSVRange range = currentHSVRange();
+        const int bounds[6] = { range.hMin, range.hMax, range.sMin, range.sMax, range.vMin, range.vMax };
+        for (int b = 0; b < 6; b++){
+            line( histImage, cv::Point(bounds[b]*bin_w, hist_h), cv::Point(bounds[b]*bin_w, 0), boundColor[b/2], 2, 8, 0 );
+        }
+    }
+}
+
+void showHistogram(const std::string &histogramWindowName, const ChannelHistogram &hist, bool displayHSVThresholdLines){
+    static thread_local cv::Mat histImage; // redrawn in place
+    renderHistogram(hist, displayHSVThresholdLines, histImage);
+
+    /// Display
+    imshow(histogramWindowName, histImage );
+}
+
+int drawHistogram(const std::string &histogramWindowName, const cv::Mat &img, bool displayHSVThresholdLines){
+    static thread_local ChannelHistogram hist;
+    computeHistogram(img, hist);
+    updateThresholdsFromHistogram(hist);
+    showHistogram(histogramWindowName, hist, displayHSVThresholdLines);
+    return 0;
+}
@@ -0,0 +1,50 @@
+/***************************************
+ H, S, V histograms of the object picture and the live feed.
+
+ Counting, threshold derivation and drawing are separate steps:
+ computeHistogram() fills integer counts for all three channels in one pass
+ (optionally on a subsampled grid), boundsFromHistogram() moves the H_MIN..V_MAX
+ bounds to the edges of the peaks straight from those counts, and
+ renderHistogram() only draws. The tracking workers count; the UI draws at
+ a limited rate, so a visible histogram never holds up tracking.
+ ************************************/
+
+#ifndef HISTOGRAM_H
+#define HISTOGRAM_H
+
+#include <opencv2/opencv.hpp>
+#include <string>
+#include "hsvThreshold.h"
+
+extern int HSVMinMaxThreshold; //horizontal line that, if the histogram rise above, set the minimum and maximum threshold values.
+extern bool lockHSVThreshold;  //locks threshold values
+
+const int HISTOGRAM_BINS = 256;
+//height of the drawn histogram. HSVMinMaxThreshold is measured on this scale.
+const int HISTOGRAM_HEIGHT = 400;
+const int HISTOGRAM_WIDTH = 512;
+//how far outside the outermost bin above HSVMinMaxThreshold the bounds are placed
+const int HISTOGRAM_MARGIN = 10;
+
+/// Pixel counts of the three channels of an 8-bit image (B,G,R or H,S,V).
+struct ChannelHistogram {
+    int counts[3][HISTOGRAM_BINS];
+    int samples; // pixels counted
+};
+
+/// Count every channel of a CV_8UC3 image in one pass. With step > 1 only every step-th pixel of every step-th row is counted.
+void computeHistogram(const cv::Mat &img, ChannelHistogram &hist, int step = 1);
+/// Move each bound of range to the lowest / highest bin (bin 0 aside) that rises above HSVMinMaxThreshold once the
+/// channel is scaled to HISTOGRAM_HEIGHT, widened by HISTOGRAM_MARGIN. Channels without such a bin keep their bounds.
+void boundsFromHistogram(const ChannelHistogram &hist, HSVRange &range);
+/// Set H_MIN..V_MAX from the histogram, unless lockHSVThreshold is set.
+void updateThresholdsFromHistogram(const ChannelHistogram &hist);
+
+/// Draw the three channel histograms into histImage, optionally with the current threshold lines.
+void renderHistogram(const ChannelHistogram &hist, bool displayHSVThresholdLines, cv::Mat &histImage);
+/// renderHistogram() and show the result in a window. Does not touch the thresholds.
+void showHistogram(const std::string &histogramWindowName, const ChannelHistogram &hist, bool displayHSVThresholdLines);
+/// Count img, update the thresholds unless they are locked, and show the histogram in a window.
+int drawHistogram(const std::string &histogramWindowName, const cv::Mat &img, bool displayHSVThresholdLines);
+
+#endif
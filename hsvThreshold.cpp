@@ -0,0 +1,219 @@
+#include "hsvThreshold.h"
+
+#include <algorithm>
+
+#if defined(__AVX2__)
+#include <immintrin.h>
+#define HSV_THRESHOLD_AVX2 1
+#elif defined(__SSE4_1__)
+#include <smmintrin.h>
+#define HSV_THRESHOLD_SSE41 1
+#endif
+
+/// Fixed point tables used by OpenCV's 8-bit BGR2HSV conversion. Using the same tables
+/// (and the same rounding) keeps the mask identical to cvtColor + inRange.
+namespace {
+
+const int hsvShift = 12;
+const int hsvRound = 1 << (hsvShift - 1);
+
+struct HSVDivTables {
+    int sdiv[256]; // (255 << 12) / v
+    int hdiv[256]; // (180 << 12) / (6 * diff)
+    HSVDivTables(){
+        sdiv[0] = hdiv[0] = 0;
+        for (int i = 1; i < 256; i++){
+            sdiv[i] = cvRound((255 << hsvShift)/(1.*i));
+            hdiv[i] = cvRound((180 << hsvShift)/(6.*i));
+        }
+    }
+};
+
+const HSVDivTables &divTables(){
+    static const HSVDivTables tables;
+    return tables;
+}
+
+/// Bounds clamped to 0..255, which is what inRange does when it converts a Scalar to 8-bit.
+struct Bounds8u {
+    int hLo, hHi, sLo, sHi, vLo, vHi;
+};
+
+inline int clamp8u(int v){
+    return std::min(std::max(v, 0), 255);
+}
+
+Bounds8u toBounds8u(const HSVRange &range){
+    Bounds8u b;
+    b.hLo = clamp8u(range.hMin); b.hHi = clamp8u(range.hMax);
+    b.sLo = clamp8u(range.sMin); b.sHi = clamp8u(range.sMax);
+    b.vLo = clamp8u(range.vMin); b.vHi = clamp8u(range.vMax);
+    return b;
+}
+
+inline uchar thresholdPixel(const uchar *p, const Bounds8u &b, const HSVDivTables &t){
+    int blue = p[0], green = p[1], red = p[2];
+    int v = std::max(std::max(blue, green), red);
+    int vmin = std::min(std::min(blue, green), red);
+    int diff = v - vmin;
+    int vr = v == red ? -1 : 0;
+    int vg = v == green ? -1 : 0;
+
+    int s = (diff*t.sdiv[v] + hsvRound) >> hsvShift;
+    int h = (vr & (green - blue)) + (~vr & ((vg & (blue - red + 2*diff)) + ((~vg) & (red - green + 4*diff))));
+    h = (h*t.hdiv[diff] + hsvRound) >> hsvShift;
+    h += h < 0 ? 180 : 0;
+
+    bool inside = h >= b.hLo && h <= b.hHi && s >= b.sLo && s <= b.sHi && v >= b.vLo && v <= b.vHi;
+    return inside ? 255 : 0;
+}
+
+#if defined(HSV_THRESHOLD_AVX2) || defined(HSV_THRESHOLD_SSE41)
+
+/// Split 16 interleaved BGR pixels (48 bytes) into one register per channel.
+inline void deinterleaveBGR(const uchar *p, __m128i &blue, __m128i &green, __m128i &red){
+    const __m128i a = _mm_loadu_si128((const __m128i*)p);
+    const __m128i b = _mm_loadu_si128((const __m128i*)(p + 16));
+    const __m128i c = _mm_loadu_si128((const __m128i*)(p + 32));
+
+    blue = _mm_or_si128(_mm_or_si128(
+        _mm_shuffle_epi8(a, _mm_setr_epi8(0, 3, 6, 9, 12, 15, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1)),
+        _mm_shuffle_epi8(b, _mm_setr_epi8(-1, -1, -1, -1, -1, -1, 2, 5, 8, 11, 14, -1, -1, -1, -1, -1))),
+        _mm_shuffle_epi8(c, _mm_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 1, 4, 7, 10, 13)));
+    green = _mm_or_si128(_mm_or_si128(
+        _mm_shuffle_epi8(a, _mm_setr_epi8(1, 4, 7, 10, 13, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1)),
+        _mm_shuffle_epi8(b, _mm_setr_epi8(-1, -1, -1, -1, -1, 0, 3, 6, 9, 12, 15, -1, -1, -1, -1, -1))),
+        _mm_shuffle_epi8(c, _mm_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 2, 5, 8, 11, 14)));
+    red = _mm_or_si128(_mm_or_si128(
+        _mm_shuffle_epi8(a, _mm_setr_epi8(2, 5, 8, 11, 14, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1, -1)),
+        _mm_shuffle_epi8(b, _mm_setr_epi8(-1, -1, -1, -1, -1, 1, 4, 7, 10, 13, -1, -1, -1, -1, -1, -1))),
+        _mm_shuffle_epi8(c, _mm_setr_epi8(-1, -1, -1, -1, -1, -1, -1, -1, -1, -1, 0, 3, 6, 9, 12, 15)));
+}
+
+/// Hue numerator (before the division by 6*diff) for 8 pixels widened to 16 bits.
+inline __m128i hueNumerator16(__m128i blue, __m128i green, __m128i red, __m128i v, __m128i diff){
+    const __m128i vr = _mm_cmpeq_epi16(v, red);
+    const __m128i vg = _mm_cmpeq_epi16(v, green);
+    const __m128i diff2 = _mm_add_epi16(diff, diff);
+    const __m128i hr = _mm_sub_epi16(green, blue);
+    const __m128i hg = _mm_add_epi16(_mm_sub_epi16(blue, red), diff2);
+    const __m128i hb = _mm_add_epi16(_mm_sub_epi16(red, green), _mm_add_epi16(diff2, diff2));
+    return _mm_add_epi16(_mm_and_si128(vr, hr),
+                         _mm_andnot_si128(vr, _mm_add_epi16(_mm_and_si128(vg, hg), _mm_andnot_si128(vg, hb))));
+}
+
+#endif
+
+#if defined(HSV_THRESHOLD_AVX2)
+
+/// Hue/saturation range test for 8 pixels. Returns 8 16-bit lanes of 0 / -1.
+inline __m128i hsInRange8(__m128i h16, __m128i v8, __m128i diff8, const HSVDivTables &t, const Bounds8u &b){
+    const __m256i round = _mm256_set1_epi32(hsvRound);
+    const __m256i v = _mm256_cvtepu8_epi32(v8);
+    const __m256i diff = _mm256_cvtepu8_epi32(diff8);
+
+    __m256i s = _mm256_mullo_epi32(diff, _mm256_i32gather_epi32(t.sdiv, v, 4));
+    s = _mm256_srai_epi32(_mm256_add_epi32(s, round), hsvShift);
+    __m256i h = _mm256_mullo_epi32(_mm256_cvtepi16_epi32(h16), _mm256_i32gather_epi32(t.hdiv, diff, 4));
+    h = _mm256_srai_epi32(_mm256_add_epi32(h, round), hsvShift);
+    h = _mm256_add_epi32(h, _mm256_and_si256(_mm256_cmpgt_epi32(_mm256_setzero_si256(), h), _mm256_set1_epi32(180)));
+
+    __m256i inside = _mm256_and_si256(_mm256_cmpgt_epi32(h, _mm256_set1_epi32(b.hLo - 1)),
+                                      _mm256_cmpgt_epi32(_mm256_set1_epi32(b.hHi + 1), h));
+    inside = _mm256_and_si256(inside, _mm256_and_si256(_mm256_cmpgt_epi32(s, _mm256_set1_epi32(b.sLo - 1)),
+                                                       _mm256_cmpgt_epi32(_mm256_set1_epi32(b.sHi + 1), s)));
+    return _mm_packs_epi32(_mm256_castsi256_si128(inside), _mm256_extracti128_si256(inside, 1));
+}
+
+#elif defined(HSV_THRESHOLD_SSE41)
+
+/// Hue/saturation range test for 4 pixels. SSE4.1 has no gather, so the table lookups stay scalar.
+inline __m128i hsInRange4(__m128i h16, const uchar *v, const uchar *diff, const HSVDivTables &t, const Bounds8u &b){
+    const __m128i round = _mm_set1_epi32(hsvRound);
+    const __m128i sd = _mm_setr_epi32(t.sdiv[v[0]], t.sdiv[v[1]], t.sdiv[v[2]], t.sdiv[v[3]]);
+    const __m128i hd = _mm_setr_epi32(t.hdiv[diff[0]], t.hdiv[diff[1]], t.hdiv[diff[2]], t.hdiv[diff[3]]);
+    const __m128i d = _mm_setr_epi32(diff[0], diff[1], diff[2], diff[3]);
+
+    __m128i s = _mm_srai_epi32(_mm_add_epi32(_mm_mullo_epi32(d, sd), round), hsvShift);
+    __m128i h = _mm_srai_epi32(_mm_add_epi32(_mm_mullo_epi32(_mm_cvtepi16_epi32(h16), hd), round), hsvShift);
+    h = _mm_add_epi32(h, _mm_and_si128(_mm_cmplt_epi32(h, _mm_setzero_si128()), _mm_set1_epi32(180)));
+
+    __m128i inside = _mm_and_si128(_mm_cmpgt_epi32(h, _mm_set1_epi32(b.hLo - 1)),
+                                   _mm_cmplt_epi32(h, _mm_set1_epi32(b.hHi + 1)));
+    return _mm_and_si128(inside, _mm_and_si128(_mm_cmpgt_epi32(s, _mm_set1_epi32(b.sLo - 1)),
+                                               _mm_cmplt_epi32(s, _mm_set1_epi32(b.sHi + 1))));
+}
+
+#endif
+
+} // namespace
+
+void hsvThresholdRow(const uchar *bgr, uchar *mask, int width, const HSVRange &range){
+    const HSVDivTables &t = divTables();
+    const Bounds8u b = toBounds8u(range);
+    int i = 0;
+
+#if defined(HSV_THRESHOLD_AVX2) || defined(HSV_THRESHOLD_SSE41)
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i vLo = _mm_set1_epi8((char)b.vLo);
+    const __m128i vHi = _mm_set1_epi8((char)b.vHi);
+
+    for (; i <= width - 16; i += 16){
+        __m128i blue, green, red;
+        deinterleaveBGR(bgr + 3*i, blue, green, red);
+
+        const __m128i v = _mm_max_epu8(_mm_max_epu8(blue, green), red);
+        const __m128i diff = _mm_subs_epu8(v, _mm_min_epu8(_mm_min_epu8(blue, green), red));
+        const __m128i vInside = _mm_and_si128(_mm_cmpeq_epi8(_mm_max_epu8(v, vLo), v),
+                                              _mm_cmpeq_epi8(_mm_min_epu8(v, vHi), v));
+
+        // hue numerator in 16 bits, low and high 8 pixels
+        const __m128i hLo = hueNumerator16(_mm_cvtepu8_epi16(blue), _mm_cvtepu8_epi16(green), _mm_cvtepu8_epi16(red),
+                                           _mm_cvtepu8_epi16(v), _mm_cvtepu8_epi16(diff));
+        const __m128i hHi = hueNumerator16(_mm_unpackhi_epi8(blue, zero), _mm_unpackhi_epi8(green, zero),
+                                           _mm_unpackhi_epi8(red, zero), _mm_unpackhi_epi8(v, zero),
+                                           _mm_unpackhi_epi8(diff, zero));
+#if defined(HSV_THRESHOLD_AVX2)
+        const __m128i insideLo = hsInRange8(hLo, v, diff, t, b);
+        const __m128i insideHi = hsInRange8(hHi, _mm_srli_si128(v, 8), _mm_srli_si128(diff, 8), t, b);
+#else
+        uchar vBuf[16], diffBuf[16];
+        _mm_storeu_si128((__m128i*)vBuf, v);
+        _mm_storeu_si128((__m128i*)diffBuf, diff);
+        const __m128i insideLo = _mm_packs_epi32(hsInRange4(hLo, vBuf, diffBuf, t, b),
+                                                 hsInRange4(_mm_srli_si128(hLo, 8), vBuf + 4, diffBuf + 4, t, b));
+        const __m128i insideHi = _mm_packs_epi32(hsInRange4(hHi, vBuf + 8, diffBuf + 8, t, b),
+                                                 hsInRange4(_mm_srli_si128(hHi, 8), vBuf + 12, diffBuf + 12, t, b));
+#endif
+        _mm_storeu_si128((__m128i*)(mask + i), _mm_and_si128(_mm_packs_epi16(insideLo, insideHi), vInside));
+    }
+#endif
+
+    for (; i < width; i++){
+        mask[i] = thresholdPixel(bgr + 3*i, b, t);
+    }
+}
+
+void hsvThreshold(const cv::Mat &bgr, const HSVRange &range, cv::Mat &mask){
+    CV_Assert(bgr.type() == CV_8UC3);
+    mask.create(bgr.rows, bgr.cols, CV_8UC1);
+
+    int rows = bgr.rows, cols = bgr.cols;
+    if (bgr.isContinuous() && mask.isContinuous()){
+        cols *= rows;
+        rows = 1;
+    }
+    for (int y = 0; y < rows; y++){
+        hsvThresholdRow(bgr.ptr<uchar>(y), mask.ptr<uchar>(y), cols, range);
+    }
+}
+
+const char *hsvThresholdPath(){
+#if defined(HSV_THRESHOLD_AVX2)
+    return "AVX2";
+#elif defined(HSV_THRESHOLD_SSE41)
+    return "SSE4.1";
+#else
+    return "scalar";
+#endif
+}
@@ -0,0 +1,36 @@
+/***************************************
+ Fused BGR -> HSV -> binary threshold.
+
+ Replaces the cv::cvtColor(COLOR_BGR2HSV) + cv::inRange pair in the tracking
+ loop with a single pass that reads the BGR camera frame and writes the
+ binary mask directly, so no intermediate HSV image is written or re-read.
+ The output is bit-identical to the OpenCV pair for 8-bit frames.
+
+ The kernel is vectorized with AVX2 or SSE4.1 when the compiler is allowed
+ to use them (e.g. -mavx2, -msse4.1 or -march=native) and falls back to a
+ scalar loop otherwise.
+ ************************************/
+
+#ifndef HSV_THRESHOLD_H
+#define HSV_THRESHOLD_H
+
+#include <opencv2/opencv.hpp>
+
+/// Inclusive HSV bounds, in the same units as the H_MIN..V_MAX trackbars (H is 0..180 for 8-bit images).
+struct HSVRange {
+    int hMin, hMax;
+    int sMin, sMax;
+    int vMin, vMax;
+};
+
+/// Threshold a CV_8UC3 BGR frame against range and write a CV_8UC1 mask (255 inside, 0 outside).
+/// Equivalent to cvtColor(bgr,hsv,COLOR_BGR2HSV) followed by inRange(hsv,lower,upper,mask).
+void hsvThreshold(const cv::Mat &bgr, const HSVRange &range, cv::Mat &mask);
+
+/// Threshold a single row of width BGR pixels. Exposed for callers that tile or crop the frame themselves.
+void hsvThresholdRow(const uchar *bgr, uchar *mask, int width, const HSVRange &range);
+
+/// Name of the code path selected at compile time ("AVX2", "SSE4.1" or "scalar").
+const char *hsvThresholdPath();
+
+#endif
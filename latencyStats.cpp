@@ -0,0 +1,141 @@
+#include "latencyStats.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <opencv2/opencv.hpp>
+
+namespace {
+
+std::atomic<bool> instrumentationEnabled(false);
+LatencyHistogram histograms[NUM_LATENCY_STAGES];
+
+/// Stage times of the frame the calling thread is working on.
+struct FrameTrace {
+    bool active;
+    int64 lastTick;
+    int64 stageTicks[NUM_LATENCY_STAGES];
+    bool stageSeen[NUM_LATENCY_STAGES];
+};
+thread_local FrameTrace trace; // zero-initialized, so inactive until latencyFrameBegin()
+
+const double tickSeconds = 1.0/cv::getTickFrequency();
+
+} // namespace
+
+const char *latencyStageName(LatencyStage stage){
+    static const char *names[NUM_LATENCY_STAGES] = {
+        "queue", "convert", "gates", "threshold", "morph", "blob", "overlay", "record", "display",
+        "capture->decision", "capture->display"
+    };
+    return names[stage];
+}
+
+int LatencyHistogram::bucketOf(uint64_t micros){
+    if (micros < (uint64_t)EXACT_BUCKETS){return (int)micros;}
+    int octave = 0; // position of the top bit above the exact range
+    while ((micros >> (octave + 6)) != 0){octave++;}
+    if (octave >= OCTAVES){return NUM_BUCKETS - 1;}
+    int sub = (int)(micros >> (octave + 1)) & (SUB_BUCKETS - 1);
+    return EXACT_BUCKETS + octave*SUB_BUCKETS + sub;
+}
+
+uint64_t LatencyHistogram::bucketUpperEdge(int bucket){
+    if (bucket < EXACT_BUCKETS){return (uint64_t)bucket;}
+    int octave = (bucket - EXACT_BUCKETS)/SUB_BUCKETS;
+    int sub = (bucket - EXACT_BUCKETS)%SUB_BUCKETS;
+    return ((uint64_t)(SUB_BUCKETS + sub + 1) << (octave + 1)) - 1;
+}
+
+void LatencyHistogram::record(double seconds){
+    uint64_t micros = seconds > 0 ? (uint64_t)(seconds*1e6 + 0.5) : 0;
+    buckets[bucketOf(micros)].fetch_add(1, std::memory_order_relaxed);
+    total.fetch_add(1, std::memory_order_relaxed);
+    sumMicros.fetch_add(micros, std::memory_order_relaxed);
+    uint64_t previous = maxMicros.load(std::memory_order_relaxed);
+    while (micros > previous && !maxMicros.compare_exchange_weak(previous, micros, std::memory_order_relaxed)){}
+}
+
+void LatencyHistogram::reset(){
+    for (int i = 0; i < NUM_BUCKETS; i++){buckets[i].store(0, std::memory_order_relaxed);}
+    total.store(0, std::memory_order_relaxed);
+    sumMicros.store(0, std::memory_order_relaxed);
+    maxMicros.store(0, std::memory_order_relaxed);
+}
+
+double LatencyHistogram::quantile(double q) const {
+    // the buckets are read while other threads may still add to them, so count them up front
+    uint64_t n = 0;
+    for (int i = 0; i < NUM_BUCKETS; i++){n += buckets[i].load(std::memory_order_relaxed);}
+    if (n == 0){return 0;}
+    uint64_t rank = (uint64_t)(q*(n - 1)) + 1, seen = 0;
+    for (int i = 0; i < NUM_BUCKETS; i++){
+        seen += buckets[i].load(std::memory_order_relaxed);
+        if (seen >= rank){return std::min(bucketUpperEdge(i), maxMicros.load(std::memory_order_relaxed))*1e-6;}
+    }
+    return max();
+}
+
+double LatencyHistogram::mean() const {
+    uint64_t n = count();
+    return n ? sumMicros.load(std::memory_order_relaxed)*1e-6/n : 0;
+}
+
+void setLatencyInstrumentation(bool enabled){instrumentationEnabled = enabled;}
+bool latencyInstrumentation(){return instrumentationEnabled.load(std::memory_order_relaxed);}
+
+double latencyClock(){return cv::getTickCount()*tickSeconds;}
+
+void latencyFrameBegin(){
+    trace.active = latencyInstrumentation();
+    if (!trace.active){return;}
+    for (int i = 0; i < NUM_LATENCY_STAGES; i++){
+        trace.stageTicks[i] = 0;
+        trace.stageSeen[i] = false;
+    }
+    trace.lastTick = cv::getTickCount();
+}
+
+void latencyMark(LatencyStage stage){
+    if (!trace.active){return;}
+    int64 now = cv::getTickCount();
+    trace.stageTicks[stage] += now - trace.lastTick;
+    trace.stageSeen[stage] = true;
+    trace.lastTick = now;
+}
+
+void latencySkip(){
+    if (trace.active){trace.lastTick = cv::getTickCount();}
+}
+
+void latencyFrameEnd(){
+    if (!trace.active){return;}
+    trace.active = false;
+    for (int i = 0; i < NUM_LATENCY_STAGES; i++){
+        if (trace.stageSeen[i]){histograms[i].record(trace.stageTicks[i]*tickSeconds);}
+    }
+}
+
+void latencyRecord(LatencyStage stage, double seconds){
+    if (latencyInstrumentation()){histograms[stage].record(seconds);}
+}
+
+const LatencyHistogram &latencyHistogram(LatencyStage stage){
+    return histograms[stage];
+}
+
+void resetLatencyHistograms(){
+    for (int i = 0; i < NUM_LATENCY_STAGES; i++){histograms[i].reset();}
+}
+
+void writeLatencyReport(std::ostream &out){
+    char line[128];
+    snprintf(line, sizeof(line), "%-18s %8s %9s %9s %9s\n", "stage", "frames", "p50 ms", "p99 ms", "max ms");
+    out << line;
+    for (int i = 0; i < NUM_LATENCY_STAGES; i++){
+        const LatencyHistogram &h = histograms[i];
+        if (h.count() == 0){continue;}
+        snprintf(line, sizeof(line), "%-18s %8llu %9.3f %9.3f %9.3f\n", latencyStageName((LatencyStage)i),
+                 (unsigned long long)h.count(), 1000*h.quantile(0.5), 1000*h.quantile(0.99), 1000*h.max());
+        out << line;
+    }
+}
@@ -0,0 +1,96 @@
+/***************************************
+ Always-on latency instrumentation for the tracking pipeline.
+
+ Every frame is stamped at capture. The detection code charges the time
+ between marks to pipeline stages (convert, threshold, morph, blob, overlay,
+ ...), and the pipeline records end-to-end latencies such as capture to
+ decision (result published to the flight controller) and capture to
+ display. Durations go into fixed-bucket log-scale histograms (16 buckets
+ per octave of microseconds, so quantiles are within about 6%) updated with
+ relaxed atomic increments: no locks, no allocation, a few clock reads per
+ frame.
+
+ Marks are only recorded on threads that called latencyFrameBegin(), so the
+ instrumented modules cost a branch when used from the benchmark or batch mode.
+ ************************************/
+
+#ifndef LATENCY_STATS_H
+#define LATENCY_STATS_H
+
+#include <atomic>
+#include <ostream>
+#include <stdint.h>
+
+enum LatencyStage {
+    // per-frame work, summed over the frame when a stage runs more than once (e.g. coarse and fine threshold)
+    STAGE_QUEUE,        // capture to the start of detection
+    STAGE_CONVERT,      // BGR to HSV for the debug windows and histogram counting
+    STAGE_GATES,        // gate target classification, clean-up and search
+    STAGE_THRESHOLD,
+    STAGE_MORPH,
+    STAGE_BLOB,
+    STAGE_OVERLAY,      // publishing the result and drawing on the feed
+    STAGE_RECORD,       // handing the annotated frame to the recorder
+    STAGE_DISPLAY,      // imshow of the processed frame on the UI thread
+    // end to end
+    STAGE_DECISION,     // capture to the detection published to the flight controller
+    STAGE_GLASS_TO_DISPLAY, // capture to the frame being shown
+    NUM_LATENCY_STAGES
+};
+
+/// Short name of a stage for reports.
+const char *latencyStageName(LatencyStage stage);
+
+/// Lock-free histogram of durations from 1 microsecond to about 30 seconds.
+class LatencyHistogram {
+public:
+    static const int EXACT_BUCKETS = 32;   // 0..31 us, one bucket each
+    static const int SUB_BUCKETS = 16;     // per octave above that
+    static const int OCTAVES = 20;
+    static const int NUM_BUCKETS = EXACT_BUCKETS + OCTAVES*SUB_BUCKETS;
+
+    LatencyHistogram(){reset();}
+
+    void record(double seconds);
+    void reset();
+
+    uint64_t count() const {return total.load(std::memory_order_relaxed);}
+    /// Duration below which fraction q of the samples fall, in seconds (upper edge of the bucket holding it).
+    double quantile(double q) const;
+    double max() const {return maxMicros.load(std::memory_order_relaxed)*1e-6;}
+    double mean() const;
+
+private:
+    static int bucketOf(uint64_t micros);
+    static uint64_t bucketUpperEdge(int bucket);
+
+    std::atomic<uint32_t> buckets[NUM_BUCKETS];
+    std::atomic<uint64_t> total;
+    std::atomic<uint64_t> sumMicros;
+    std::atomic<uint64_t> maxMicros;
+};
+
+/// Turn recording on or off for the whole process (off by default).
+void setLatencyInstrumentation(bool enabled);
+bool latencyInstrumentation();
+
+/// Seconds on the clock the pipeline stamps its frames with (cv::getTickCount based).
+double latencyClock();
+
+/// Start timing a frame on this thread.
+void latencyFrameBegin();
+/// Charge the time since the previous mark (or latencyFrameBegin) to stage. Ignored outside a frame.
+void latencyMark(LatencyStage stage);
+/// Restart the lap without charging anything, e.g. after waiting on a lock.
+void latencySkip();
+/// Record the stage times collected since latencyFrameBegin() and end the frame.
+void latencyFrameEnd();
+/// Record a duration measured across threads, e.g. now - captureTime.
+void latencyRecord(LatencyStage stage, double seconds);
+
+const LatencyHistogram &latencyHistogram(LatencyStage stage);
+void resetLatencyHistograms();
+/// One line per stage with samples: count, p50, p99 and max in milliseconds.
+void writeLatencyReport(std::ostream &out);
+
+#endif
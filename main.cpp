@@ -4,20 +4,93 @@
  2.) Press 'b' key to take picture.
  5.) Adjust H,S,V sliders such that the peaks are bounded on the histogram.
  6.) Track!  Yaw = -1 indicates a neccesary yaw to left, Yaw = 0 is center, and Yaw = 1 is to the right.  Pitch behaves similarly.
+     Every tracked frame is published to the flight controller through shared memory (see flightOutput.h).
  7.) Press 'q' key to quit.
  8.) Press '1' to pause tracking.
  9.) Press '2' to show HSV and Binary videofeeds.
  10.) Press '3' to show live histograms of BGR and HSV videofeeds.
  11.) Press '4' to start tracking a new object.
+ 12.) Press '5' to toggle predictive tracking (only a window around the predicted position is searched while the object is locked).
+ 13.) Press '6' to register the current H,S,V thresholds as an additional gate target. Every gate is tracked alongside the main object.
+     Gate 1 is the start/finish line and the others are checkpoints: lap and split times are shown on the feed and printed on exit.
+ 14.) Press '7' to restart race timing.
+ 15.) Press '8' to cycle the detection decimation (1x, 2x, 4x): the full-frame search runs on a smaller image and is refined
+     at full resolution around the object. With predictive tracking on, only the searches while the object is lost are decimated.
+ 16.) Press '9' to print the latency report: p50/p99/max time of each detection stage, capture to decision (result published)
+     and capture to display, and the frames dropped so far.
+ 17.) Press 'r' to save an instant replay clip of the last seconds of the feed. Clips are also saved for every lap and checkpoint.
+ 18.) Press '0' to toggle tile skipping for a camera that does not move: only the parts of the frame that changed are
+     thresholded and cleaned up again, the rest keeps its mask. The share of tiles skipped is shown on the feed.
+     Used while predictive tracking is off or the object is not tracked, at 1x decimation.
+ With --profile, steps 1-5 are skipped when the profile exists: its thresholds and gates are used from the first frame.
+ The profile is saved again whenever the object is initialized ('4') or a gate is added ('6').
+
+ Command line:
+   QuadRacingSoftware                      track the default camera
+   QuadRacingSoftware --file video.mp4     track a recorded video interactively
+   QuadRacingSoftware --decimate N         start with detection decimated N times (interactive and batch)
+   QuadRacingSoftware --tiles              start with tile skipping on (interactive, batch and --camera)
+   QuadRacingSoftware --profile race.qrp   load the thresholds and gate targets from a calibration profile instead of
+                                           calibrating, and save them there (interactive). Batch and --camera runs take
+                                           the thresholds and targets they are not given from the profile.
+   QuadRacingSoftware --latency-log file [--latency-interval seconds]
+                                           append the latency report to file every 10 (or the given) seconds
+   QuadRacingSoftware --no-latency         turn the latency histograms off
+   QuadRacingSoftware --control-shm name   publish detections to another shared memory object (default /quadracing-control)
+   QuadRacingSoftware --no-control-shm     do not publish to shared memory
+   QuadRacingSoftware --control-udp host:port
+                                           also send every detection as a UDP datagram
+   QuadRacingSoftware --record feed.avi    record the annotated feed
+   QuadRacingSoftware --replay-seconds N --replay-mb M --clip-prefix path
+                                           instant replay ring length (default 10 s, 0 = off), its memory budget (default 256 MB)
+                                           and where clips are written (default ./replay-<frame>-lap<N>-gate<M>.avi)
+   QuadRacingSoftware --batch [--hsv hMin,hMax,sMin,sMax,vMin,vMax] [--threads N] [--output log.csv|log.bin] [--no-morph] [--roi] [--decimate N] [--tiles]
+                           [--target name:hMin,hMax,sMin,sMax,vMin,vMax ...] video.mp4 ...
+                                           headless: process videos as fast as possible and write a per-frame detection log
+   QuadRacingSoftware --camera name:input[:hMin,hMax,sMin,sMax,vMin,vMax] ... [--threads N] [--realtime] [--seconds N]
+                      [--no-morph] [--roi] [--decimate N] [--tiles] [--scaling]
+                                           headless: track one camera (device number) or video file per gate on a shared
+                                           work-stealing pool, the first camera being the start/finish line. --realtime plays
+                                           files at their frame rate, --scaling reruns the files with 1, 2, 4 ... workers.
+                                           A camera without thresholds uses the --profile gate of the same name, or the
+                                           profile's object thresholds
  
  ************************************/
 
 // include the necessary libraries
+#include <fstream>
 #include <iostream>
-#include <opencv2/opencv.hpp>
+#include <memory>
+#include "openCVCompat.h"
 #include <sstream>
 #include <string>
 #include <stdio.h>
+#include <stdlib.h>
+#include <algorithm>
+#include <atomic>
+#include <chrono>
+#include <ctime>
+#include <mutex>
+#include <thread>
+#include <vector>
+#include "allocationCounter.h"
+#include "frameQueue.h"
+#include "framePool.h"
+#include "frameSequencer.h"
+#include "batchMode.h"
+#include "calibrationProfile.h"
+#include "colorClassifier.h"
+#include "feedRecorder.h"
+#include "flightOutput.h"
+#include "histogram.h"
+#include "hsvThreshold.h"
+#include "latencyStats.h"
+#include "multiCameraTracker.h"
+#include "objectTracking.h"
+#include "pyramidDetector.h"
+#include "raceTiming.h"
+#include "roiTracker.h"
+#include "tileChangeDetector.h"
 //////////////////////////////////////////////////////////////////////////////////////////////////
 //Credit given to Kyle Hounslow 2013 for basic shell of color tracking program.
 //Credit given to OpenCV for library development.
@@ -38,48 +111,40 @@
 //////////////////////////////////////////////////////////////////////////////////////////////////
 
 //using namespace cv;
-//initial min and max HSV filter values.
-//these will be changed using trackbars
-int H_MIN = 0;
-int H_MAX = 256;
-int S_MIN = 0;
-int S_MAX = 256;
-int V_MIN = 0;
-int V_MAX = 256;
-int HSVMinMaxThreshold = 3; //horizontal line that, if the histogram rise above, set the minimum and maximum threshold values.
-bool lockHSVThreshold = false;//locks threshold values
-//default capture width and height
-const int FRAME_WIDTH = 1280;
-const int FRAME_HEIGHT = 720;
-//max number of objects to be detected in frame
-const int MAX_NUM_OBJECTS=50;
-//minimum and maximum object area
-const int MIN_OBJECT_AREA = 10*10;
-const int MAX_OBJECT_AREA = FRAME_HEIGHT*FRAME_WIDTH/1.5;
 //names that will appear at the top of each window
-const cv::string windowName = "Object Tracking: Press 'q' to quit.";
-const cv::string windowName1 = "HSV Image";
-const cv::string windowName2 = "Thresholded Image";
-const cv::string windowName3 = "After Morphological Operations";
-const cv::string trackbarWindowName = "Trackbars";
+const std::string windowName = "Object Tracking: Press 'q' to quit.";
+const std::string windowName1 = "HSV Image";
+const std::string windowName2 = "Thresholded Image";
+const std::string windowName3 = "After Morphological Operations";
+const std::string trackbarWindowName = "Trackbars";
 
-/// Variables to be publicly returned to flight control program
-int yaw = 0;
-int pitch = 0;
-bool objectFound = false;
+//the live histograms are counted on every second pixel of every second row and redrawn at most 10 times a second
+const int HISTOGRAM_STEP = 2;
+const double HISTOGRAM_REFRESH_SECONDS = 0.1;
 
 /// Variable to control camera input or file input
 bool fromCamera = true;
+/// Decimation factor of the full-frame search, 1 = full resolution
+int initialDecimation = 1;
+/// Threshold only the tiles of the frame that changed
+bool initialTileSkipping = false;
+/// Latency histograms: on unless --no-latency, written to latencyLog every latencyLogInterval seconds when it is set
+bool latencyStats = true;
+std::string latencyLog;
+double latencyLogInterval = 10;
+/// Flight controller output: shared memory object (empty = none) and optional UDP destination (port 0 = none)
+std::string controlShm = DEFAULT_FLIGHT_OUTPUT_NAME;
+std::string controlUdpHost;
+int controlUdpPort = 0;
+/// Recording and instant replay of the annotated feed
+RecorderOptions recorderOptions;
+/// Calibration profile loaded at startup and saved whenever the thresholds or gates change, none when empty
+std::string profileFile;
+std::string videoFile = "/Users/Swanson/Downloads/Object Recognition%2C Flight 2.mp4";
 
 void on_trackbar( int, void* ){//This function gets called whenever a trackbar position is changed
 // Originally by Kyle Hounslow 2013
 }
-cv::string intToString(int number){
-// Originally by Kyle Hounslow 2013
-	std::stringstream ss;
-	ss << number;
-	return ss.str();
-}
 void createTrackbars(){
 // Originally by Kyle Hounslow 2013
 	//create window for trackbars
@@ -99,223 +164,6 @@ void createTrackbars(){
     cv::createTrackbar( "V_MAX (Red)", trackbarWindowName, &V_MAX, V_MAX, on_trackbar );
 }
 
-void drawObject(int x, int y,cv::Mat &frame){
-// Originally by Kyle Hounslow 2013
-	//use some of the openCV drawing functions to draw crosshairs
-	//on your tracked image!
-    
-    //UPDATE:JUNE 18TH, 2013
-    //added 'if' and 'else' statements to prevent
-    //memory errors from writing off the screen (ie. (-25,-25) is not within the window!)
-    cv::Scalar color = cv::Scalar(0,255,0);
-    
-	circle(frame,cv::Point(x,y),20,color,2);
-    if(y-25>0)
-        line(frame,cv::Point(x,y),cv::Point(x,y-25),color,2);
-    else line(frame,cv::Point(x,y),cv::Point(x,0),color,2);
-    if(y+25<FRAME_HEIGHT)
-        line(frame,cv::Point(x,y),cv::Point(x,y+25),color,2);
-    else line(frame,cv::Point(x,y),cv::Point(x,FRAME_HEIGHT),color,2);
-    if(x-25>0)
-        line(frame,cv::Point(x,y),cv::Point(x-25,y),color,2);
-    else line(frame,cv::Point(x,y),cv::Point(0,y),color,2);
-    if(x+25<FRAME_WIDTH)
-        line(frame,cv::Point(x,y),cv::Point(x+25,y),color,2);
-    else line(frame,cv::Point(x,y),cv::Point(FRAME_WIDTH,y),color,2);
-    
-	putText(frame,intToString(x)+","+intToString(y),cv::Point(x,y+30),1,1,color,2);
-    
-}
-void morphOps(cv::Mat &thresh){
-// Originally by Kyle Hounslow 2013
-	//create structuring element that will be used to "dilate" and "erode" image.
-	//the element chosen here is a 3px by 3px rectangle
-    
-    cv::Mat erodeElement = getStructuringElement( cv::MORPH_RECT,cv::Size(3,3));
-    //dilate with larger element so make sure object is nicely visible
-    cv::Mat dilateElement = getStructuringElement( cv::MORPH_RECT,cv::Size(8,8));
-    
-	erode(thresh,thresh,erodeElement);
-	erode(thresh,thresh,erodeElement);
-    
-    
-	dilate(thresh,thresh,dilateElement);
-	dilate(thresh,thresh,dilateElement);
-    dilate(thresh,thresh,dilateElement);
-    dilate(thresh,thresh,dilateElement);
-}
-void trackFilteredObject(int &x, int &y, cv::Mat threshold, cv::Mat &cameraFeed){
-// Originally by Kyle Hounslow 2013
-// Yaw and pitch notification by E. Schnipke - Feb. 5th, 2014
-    cv::Mat temp;
-    int yawPadding = 100; // how wide the center yaw area is in pixels
-    int pitchPadding = 100; // how tall the center pitch area is in pixels
-	threshold.copyTo(temp);
-	//these two vectors needed for output of findContours
-	cv::vector< cv::vector<cv::Point> > contours;
-    cv::vector<cv::Vec4i> hierarchy;
-	//find contours of filtered image using openCV findContours function
-    findContours(temp,contours,hierarchy,CV_RETR_CCOMP,CV_CHAIN_APPROX_SIMPLE );
-	//use moments method to find our filtered object
-	double refArea = 0;
-
-	if (hierarchy.size() > 0) {
-		int numObjects = hierarchy.size();
-        //if number of objects greater than MAX_NUM_OBJECTS we have a noisy filter
-        if(numObjects<MAX_NUM_OBJECTS){
-			for (int index = 0; index >= 0; index = hierarchy[index][0]) {
-                
-                cv::Moments moment = moments((cv::Mat)contours[index]);
-				double area = moment.m00;
-                
-				//if the area is less than 20 px by 20px then it is probably just noise
-				//if the area is the same as the 3/2 of the image size, probably just a bad filter
-				//we only want the object with the largest area so we safe a reference area each
-				//iteration and compare it to the area in the next iteration.
-                if(area>MIN_OBJECT_AREA && area<MAX_OBJECT_AREA && area>refArea){
-					x = moment.m10/area;
-					y = moment.m01/area;
-					objectFound = true;
-					refArea = area;
-				}else objectFound = false;
-                
-                
-			}
-			//let user know you found an object
-			if(objectFound ==true){
-                putText(cameraFeed,"Tracking Object",cv::Point(0,50),2,1,cv::Scalar(0,255,0),2);
-                // let user know whether object is to left of screen, center, or to right of screen
-                if (x<(FRAME_WIDTH - yawPadding)/2) {
-                    yaw = -1; //left
-                }else if(x>(FRAME_WIDTH + yawPadding)/2){
-                    yaw = 1; //right
-                }else{
-                    yaw = 0; //center
-                }
-                putText(cameraFeed, "Yaw = " + intToString(yaw), cv::Point(0,100),2,1,cv::Scalar(0,255,0),2);
-                
-                // let user know whether object is to the top, center, or bottom of screen
-                if (y<(FRAME_HEIGHT - pitchPadding)/2) {
-                    pitch = -1; //bottom
-                }else if(y>(FRAME_HEIGHT + pitchPadding)/2){
-                    pitch = 1; //top
-                }else{
-                    pitch = 0; //center
-                }
-                putText(cameraFeed, "Pitch = " + intToString(pitch), cv::Point(0,150),2,1,cv::Scalar(0,255,0),2);
-
-				//draw object location on screen
-				drawObject(x,y,cameraFeed);}
-            
-		}else putText(cameraFeed,"TOO MUCH NOISE! ADJUST FILTER",cv::Point(0,50),1,2,cv::Scalar(0,0,255),2);
-	}
-}
-int drawHistogram(cv::String histogramWindowName, cv::Mat img, bool displayHSVThresholdLines){
-// Originally by E. Schnipke Feb. 5th, 2014
-    /// Separate the HSV image in 3 places ( Hue, Saturation, and Value )
-    cv::vector<cv::Mat> hsv_planes;
-    split( img, hsv_planes );
-    
-    /// Establish the number of bins
-    int HistSize = 256;
-    
-    /// Set the ranges ( for H,S,V )
-    float hRange[] = { 0, 256 } ;
-    float sRange[] = { 0, 256 } ;
-    float vRange[] = { 0, 256 } ;
-    const float* hHistRange = { hRange };
-    const float* sHistRange = { sRange };
-    const float* vHistRange = { vRange };
-    
-    bool uniform = true; bool accumulate = false;
-    
-    cv::Mat h_hist, s_hist, v_hist;
-    
-    /// Compute the histograms:
-    calcHist( &hsv_planes[0], 1, 0, cv::Mat(), h_hist, 1, &HistSize, &hHistRange, uniform, accumulate );
-    calcHist( &hsv_planes[1], 1, 0, cv::Mat(), s_hist, 1, &HistSize, &sHistRange, uniform, accumulate );
-    calcHist( &hsv_planes[2], 1, 0, cv::Mat(), v_hist, 1, &HistSize, &vHistRange, uniform, accumulate );
-    
-    /// Draw the histograms for H, S, and V
-    int hist_w = 512; int hist_h = 400;
-    int hbin_w = cvRound( (double) hist_w/HistSize );
-    int sbin_w = cvRound( (double) hist_w/HistSize );
-    int vbin_w = cvRound( (double) hist_w/HistSize );
-    
-    cv::Mat histImage( hist_h, hist_w, CV_8UC3, cv::Scalar( 0,0,0) );
-    
-    /// Normalize the result to [ 0, histImage.rows ]
-    normalize(h_hist, h_hist, 0, histImage.rows, cv::NORM_MINMAX, -1, cv::Mat() );
-    normalize(s_hist, s_hist, 0, histImage.rows, cv::NORM_MINMAX, -1, cv::Mat() );
-    normalize(v_hist, v_hist, 0, histImage.rows, cv::NORM_MINMAX, -1, cv::Mat() );
-
-    /// Draw histogram for each channel
-    for(int i = 1; i < HistSize; i++){
-        // Hue channel
-        line( histImage, cv::Point( hbin_w*(i-1), hist_h - cvRound(h_hist.at<float>(i-1)) ) ,
-             cv::Point( hbin_w*(i), hist_h - cvRound(h_hist.at<float>(i)) ),
-             cv::Scalar( 255, 0, 0), 2, 8, 0  );
-        // Saturation channel
-        line( histImage, cv::Point( sbin_w*(i-1), hist_h - cvRound(s_hist.at<float>(i-1)) ) ,
-             cv::Point( sbin_w*(i), hist_h - cvRound(s_hist.at<float>(i)) ),
-             cv::Scalar( 0, 255, 0), 2, 8, 0  );
-        // Value channel
-        line( histImage, cv::Point( vbin_w*(i-1), hist_h - cvRound(v_hist.at<float>(i-1)) ) ,
-             cv::Point( vbin_w*(i), hist_h - cvRound(v_hist.at<float>(i)) ),
-             cv::Scalar( 0, 0, 255), 2, 8, 0  );
-    }
-    
-    for (int i = 1; i < HistSize; i++){ // Analyze histograms from left to right and set max thresholds to last value above threshold value (+ buffer).
-        if(h_hist.at<float>(i)>HSVMinMaxThreshold && !lockHSVThreshold){H_MAX=i+10;}
-        if(s_hist.at<float>(i)>HSVMinMaxThreshold && !lockHSVThreshold){S_MAX=i+10;}
-        if(v_hist.at<float>(i)>HSVMinMaxThreshold && !lockHSVThreshold){V_MAX=i+10;}
-    }
-    
-    for (int i = HistSize; i > 0; i--){ // Analyze histograms from right to left and set min thresholds to last value above threshold value (- buffer).
-        if(h_hist.at<float>(i)>HSVMinMaxThreshold && !lockHSVThreshold){H_MIN=i-10;}
-        if(s_hist.at<float>(i)>HSVMinMaxThreshold && !lockHSVThreshold){S_MIN=i-10;}
-        if(v_hist.at<float>(i)>HSVMinMaxThreshold && !lockHSVThreshold){V_MIN=i-10;}
-    }
-    
-    /// Plot threshold lines on histogram
-    if (displayHSVThresholdLines){
-        // Plot lower Hue threshold line
-        line( histImage,
-             cv::Point(H_MIN*hbin_w, hist_h) ,
-             cv::Point(H_MIN*hbin_w, 0),
-             cv::Scalar( 255, 200, 200), 2, 8, 0  );
-        // Plot upper Hue threshold line
-        line( histImage,
-             cv::Point(H_MAX*hbin_w, hist_h) ,
-             cv::Point(H_MAX*hbin_w, 0),
-             cv::Scalar( 255, 200, 200), 2, 8, 0  );
-        // Plot lower Saturation threshold line
-        line( histImage,
-             cv::Point(S_MIN*sbin_w, hist_h) ,
-             cv::Point(S_MIN*sbin_w, 0),
-             cv::Scalar( 200, 255, 200), 2, 8, 0  );
-        // Plot upper Saturation threshold line
-        line( histImage,
-             cv::Point(S_MAX*sbin_w, hist_h) ,
-             cv::Point(S_MAX*sbin_w, 0),
-             cv::Scalar( 200, 255, 200), 2, 8, 0  );
-        // Plot lower Value threshold line
-        line( histImage,
-             cv::Point(V_MIN*vbin_w, hist_h) ,
-             cv::Point(V_MIN*vbin_w, 0),
-             cv::Scalar( 200, 200, 255), 2, 8, 0  );
-        // Plot upper Value threshold line
-        line( histImage,
-             cv::Point(V_MAX*vbin_w, hist_h) ,
-             cv::Point(V_MAX*vbin_w, 0),
-             cv::Scalar( 200, 200, 255), 2, 8, 0  );
-    }
-    
-    /// Display
-    imshow(histogramWindowName, histImage );
-    
-    return 0;
-}
 int objectInitialization(cv::VideoCapture &vid, bool displayInitialization){
 // Originally by E. Schnipke Feb. 6th, 2014.
     cv::Mat pict;// capture picture of initialized object
@@ -358,23 +206,493 @@ int objectInitialization(cv::VideoCapture &vid, bool displayInitialization){
     
     return 0;
 }
-int colorRecognition(){
+//frames after which a pipeline counts as warmed up: every pooled buffer has been sized and every worker has run
+const long ALLOCATION_WARMUP_FRAMES = 100;
+
+/// Capture thread -> detection worker(s) -> UI, connected by bounded lock-free rings.
+/// Both rings drop their oldest frame when full so the tracker always works on the freshest frame.
+/// Frames come from a FramePool sized for every ring slot, worker and the UI, so the loop reuses its buffers.
+/// The UI stage (imshow/waitKey) is driven by the caller on the main thread, since highgui is not thread safe.
+class TrackingPipeline {
+public:
+    static const int CAPTURE_QUEUE_SIZE = 4;
+    static const int DISPLAY_QUEUE_SIZE = 2;
+
+    TrackingPipeline(cv::VideoCapture &vid, int workers, bool dropFrames)
+    : paused(false), buildHSV(false), buildHistograms(false), trackObjects(true), useMorphOps(true), roiTracking(true), decimation(1), tileSkipping(false), recorder(0),
+      capture(vid), numWorkers(workers), dropCapturedFrames(dropFrames),
+      captureQueue(CAPTURE_QUEUE_SIZE), displayQueue(DISPLAY_QUEUE_SIZE),
+      // every ring slot, one frame per worker, the frame on screen and the one being captured
+      poolFrameSize(captureFrameSize(vid)), pool(CAPTURE_QUEUE_SIZE + DISPLAY_QUEUE_SIZE + workers + 2, poolFrameSize), shownFrame(0),
+      running(false), captureDone(false), frameCount(0), pendingFrames(0), captureDropCount(0), displayDropCount(0), staleFrameCount(0),
+      steadyStateFrames(0), steadyStateAllocationCount(0), bufferReallocationCount(0),
+      x(0), y(0), lastTrackedFrame(-1) {}
+    ~TrackingPipeline(){stop();}
+
+    void start(){
+        if (running){return;}
+        running = true;
+        captureDone = false;
+        roiTracker.reset();
+        {
+            //frames still queued when the pipeline stopped were never timed, timing resumes with the next capture
+            std::lock_guard<std::mutex> lock(timingMutex);
+            timingOrder.reset(frameCount);
+        }
+        threads.push_back(std::thread(&TrackingPipeline::captureLoop, this));
+        for (int i = 0; i < numWorkers; i++){
+            threads.push_back(std::thread(&TrackingPipeline::detectionLoop, this));
+        }
+    }
+    void stop(){
+        running = false;
+        for (size_t i = 0; i < threads.size(); i++){threads[i].join();}
+        threads.clear();
+        FramePacket *packet;
+        while (captureQueue.pop(packet)){pool.release(packet);}
+        while (displayQueue.pop(packet)){pool.release(packet);}
+        pool.release(shownFrame);
+        shownFrame = 0;
+        pendingFrames = 0;
+    }
+
+    /// Newest processed frame, if one arrived since the last call, otherwise 0. Older processed frames go back
+    /// to the pool. The returned frame belongs to the caller until the next call that returns a frame, or stop().
+    FramePacket *latestFrame(){
+        FramePacket *newest = 0, *packet;
+        while (displayQueue.pop(packet)){
+            pool.release(newest);
+            newest = packet;
+        }
+        if (newest){
+            pool.release(shownFrame);
+            shownFrame = newest;
+        }
+        return newest;
+    }
+    /// Register another gate target. Workers pick up the new classification table with their next frame.
+    bool addGate(const std::string &name, const HSVRange &range){
+        std::shared_ptr<const ColorClassifier> current = std::atomic_load(&gates);
+        std::shared_ptr<ColorClassifier> updated = current ? std::make_shared<ColorClassifier>(*current) : std::make_shared<ColorClassifier>();
+        if (updated->addTarget(name, range) < 0){return false;}
+        std::atomic_store(&gates, std::shared_ptr<const ColorClassifier>(updated));
+        timing.setNumCheckpoints(updated->numTargets());
+        return true;
+    }
+    /// Replace the gate targets with an already built classifier, e.g. the one of a calibration profile.
+    void setGates(const std::shared_ptr<const ColorClassifier> &classifier){
+        std::atomic_store(&gates, classifier);
+        timing.setNumCheckpoints(classifier ? classifier->numTargets() : 1);
+    }
+    std::shared_ptr<const ColorClassifier> gateTargets() const {return std::atomic_load(&gates);}
+    /// True once the capture source ran out of frames and every captured frame has been handled.
+    bool finished() const {return captureDone && pendingFrames == 0;}
+    long capturedFrames() const {return frameCount;}
+    /// Size of the frames the pool was built for.
+    cv::Size frameSize() const {return poolFrameSize;}
+    /// Frames dropped unprocessed because the workers fell behind the camera, processed frames replaced before
+    /// the UI showed them, and frames a worker finished after a newer one had already been tracked.
+    long captureDrops() const {return captureDropCount;}
+    long displayDrops() const {return displayDropCount;}
+    long staleFrames() const {return staleFrameCount;}
+    /// Tiles of every frame that went through tile skipping.
+    TileStats tileStats() const {
+        std::lock_guard<std::mutex> lock(trackerMutex);
+        return tileDetector.total();
+    }
+    /// Frames captured and processed after warm-up, and the heap allocations (debug builds only) and
+    /// frame buffer reallocations the capture and detection threads made for them.
+    long steadyStateFrameCount() const {return steadyStateFrames;}
+    long steadyStateAllocations() const {return steadyStateAllocationCount;}
+    long bufferReallocations() const {return bufferReallocationCount;}
+
+    std::atomic<bool> paused;       // detection workers discard frames while paused
+    std::atomic<bool> buildHSV;     // build the HSV image for the debug windows
+    std::atomic<bool> buildHistograms; // count the BGR and HSV histograms for the histogram windows
+    std::atomic<bool> trackObjects;
+    std::atomic<bool> useMorphOps;
+    std::atomic<bool> roiTracking;  // search only a window around the predicted object position
+    std::atomic<int> decimation;    // full-frame searches run coarse-to-fine on a frame this many times smaller
+    std::atomic<bool> tileSkipping; // full-resolution searches threshold only the tiles that changed (fixed camera)
+    RaceTiming timing;              // lap and checkpoint times from the gate targets
+    FlightOutput output;            // every tracked frame's detection, for the flight controller
+    FeedRecorder *recorder;         // gets every processed frame and the gate crossings when set, before start()
+
+private:
+    static cv::Size captureFrameSize(cv::VideoCapture &vid){
+        cv::Size size((int)vid.get(CV_CAP_PROP_FRAME_WIDTH), (int)vid.get(CV_CAP_PROP_FRAME_HEIGHT));
+        return size.width > 0 && size.height > 0 ? size : cv::Size(FRAME_WIDTH, FRAME_HEIGHT);
+    }
+
+    void captureLoop(){
+        while (running){
+            FramePacket *packet = pool.acquire();
+            if (!packet){
+                // every frame is in flight: reuse the oldest one that is still waiting for a worker
+                if (dropCapturedFrames && captureQueue.pop(packet)){
+                    skipTiming(packet->frameIndex);
+                    captureDropCount++;
+                    pendingFrames--;
+                }else{
+                    std::this_thread::yield();
+                    continue;
+                }
+            }
+            long allocations = threadAllocationCount();
+            const uchar *buffer = packet->cameraFeed.data;
+            if (!capture.read(packet->cameraFeed) || packet->cameraFeed.empty()){
+                pool.release(packet);
+                captureDone = true;
+                return;
+            }
+            packet->captureTime = latencyClock();
+            packet->frameIndex = frameCount++;
+            if (packet->frameIndex >= ALLOCATION_WARMUP_FRAMES){
+                steadyStateAllocationCount += threadAllocationCount() - allocations;
+                if (packet->cameraFeed.data != buffer){bufferReallocationCount++;}
+            }
+            pendingFrames++;
+            if (dropCapturedFrames){
+                int dropped = captureQueue.pushDropOldest(packet, [this](FramePacket *oldest){
+                    skipTiming(oldest->frameIndex);
+                    pool.release(oldest);
+                });
+                captureDropCount += dropped;
+                pendingFrames -= dropped;
+            }else{
+                // recorded footage: wait for the workers instead of skipping frames
+                while (running && !captureQueue.push(packet)){std::this_thread::yield();}
+            }
+        }
+    }
+    void detectionLoop(){
+        FramePacket *packet;
+        while (running){
+            if (!captureQueue.pop(packet)){
+                std::this_thread::sleep_for(std::chrono::microseconds(200));
+                continue;
+            }
+            long allocations = threadAllocationCount();
+            const uchar *thresholdBuffer = packet->threshold.data;
+            const uchar *hsvBuffer = packet->HSV.data;
+            latencyRecord(STAGE_QUEUE, latencyClock() - packet->captureTime);
+            latencyFrameBegin();
+            bool skipped = paused;
+            if (skipped){skipTiming(packet->frameIndex);}
+            bool show = !skipped && processFrame(*packet);
+            if (show && recorder){
+                //copies the frame and returns, or drops it when the encoder is behind
+                recorder->submit(packet->cameraFeed, packet->frameIndex, packet->captureTime);
+                latencyMark(STAGE_RECORD);
+            }
+            latencyFrameEnd();
+            if (!skipped && !show){staleFrameCount++;}
+            if (packet->frameIndex >= ALLOCATION_WARMUP_FRAMES){
+                steadyStateFrames++;
+                steadyStateAllocationCount += threadAllocationCount() - allocations;
+                if (packet->threshold.data != thresholdBuffer || packet->HSV.data != hsvBuffer){bufferReallocationCount++;}
+            }
+            if (show){
+                int dropped = displayQueue.pushDropOldest(packet, [this](FramePacket *oldest){pool.release(oldest);});
+                displayDropCount += dropped;
+            }else{
+                pool.release(packet);
+            }
+            pendingFrames--;
+        }
+    }
+    /// Returns false if the frame was skipped because a newer frame has already been tracked.
+    bool processFrame(FramePacket &packet){
+        //convert frame from BGR to HSV colorspace only when a debug window shows it
+        packet.hasHSV = buildHSV;
+        if(packet.hasHSV){cv::cvtColor(packet.cameraFeed,packet.HSV,cv::COLOR_BGR2HSV);}
+        //the histogram windows only draw, the counting is done here before the overlay is drawn on the feed
+        packet.hasHistograms = buildHistograms && packet.hasHSV;
+        if(packet.hasHistograms){
+            computeHistogram(packet.cameraFeed, packet.bgrHistogram, HISTOGRAM_STEP);
+            computeHistogram(packet.HSV, packet.hsvHistogram, HISTOGRAM_STEP);
+        }
+        latencyMark(STAGE_CONVERT);
+
+        //gate targets share one lookup table pass, however many there are
+        std::shared_ptr<const ColorClassifier> gateClassifier = std::atomic_load(&gates);
+        bool haveGates = gateClassifier && gateClassifier->numTargets() > 0;
+        if (haveGates){
+            detectTargets(*gateClassifier, packet.cameraFeed, useMorphOps, packet.gateMasks, packet.gateDetections);
+            updateTiming(packet);
+        }else{
+            packet.gateDetections.clear();
+            skipTiming(packet.frameIndex);
+        }
+        latencyMark(STAGE_GATES);
+
+        //the object is searched for before the gate labels and lap times are drawn, so the overlay is never
+        //thresholded along with the frame
+        if (!detectObject(packet)){return false;}
+        if (haveGates){
+            for (size_t t = 0; t < packet.gateDetections.size(); t++){
+                const Detection &gate = packet.gateDetections[t];
+                if (gate.found){drawLabelledObject(gate.x, gate.y, gateClassifier->target((int)t).name, packet.cameraFeed);}
+            }
+            drawTiming(packet);
+            latencyMark(STAGE_OVERLAY);
+        }
+        return true;
+    }
+
+    /// Threshold, clean up and search the frame for the object. Returns false if the frame was skipped
+    /// because a newer frame has already been tracked.
+    bool detectObject(FramePacket &packet){
+        if(trackObjects && roiTracking){
+            //predictive tracking needs every frame in order, so threshold, morphology and blob search
+            //all run under the tracker lock. they only cover the search window while the object is locked.
+            std::lock_guard<std::mutex> lock(trackerMutex);
+            if (packet.frameIndex <= lastTrackedFrame){return false;}
+            latencySkip(); // waiting for the lock is not charged to a stage, it shows up in capture->decision
+            roiTracker.setDecimation(decimation);
+            Detection detection = roiTracker.detect(packet.cameraFeed, currentHSVRange(), useMorphOps, packet.frameIndex, packet.hasHSV ? &packet.threshold : 0);
+            cv::Rect window = roiTracker.lastWindow();
+            if (window.width < packet.cameraFeed.cols || window.height < packet.cameraFeed.rows){
+                rectangle(packet.cameraFeed, window, cv::Scalar(255,255,0), 1);
+            }
+            publishDetection(detection, packet);
+            lastTrackedFrame = packet.frameIndex;
+            return true;
+        }
+
+        //coarse-to-fine: threshold, clean up and search a decimated frame, then refine around the object.
+        //the full-size mask is only assembled when a debug window shows it.
+        if(decimation > 1){
+            static thread_local PyramidDetector pyramid;
+            pyramid.setDecimation(decimation);
+            Detection detection = pyramid.detect(packet.cameraFeed, currentHSVRange(), useMorphOps, packet.hasHSV ? &packet.threshold : 0);
+            if(trackObjects){
+                std::lock_guard<std::mutex> lock(trackerMutex);
+                if (packet.frameIndex <= lastTrackedFrame){return false;}
+                latencySkip();
+                publishDetection(detection, packet);
+                lastTrackedFrame = packet.frameIndex;
+            }
+            return true;
+        }
+
+        //fixed camera: only the tiles that changed are thresholded and cleaned up again. the tile masks carry over
+        //from frame to frame, so the frames go through in order under the tracker lock.
+        if(tileSkipping){
+            std::lock_guard<std::mutex> lock(trackerMutex);
+            if (packet.frameIndex <= lastTrackedFrame){return false;}
+            latencySkip();
+            tileDetector.threshold(packet.cameraFeed, currentHSVRange(), useMorphOps, packet.threshold);
+            latencyMark(STAGE_THRESHOLD);
+            if(trackObjects){
+                Detection detection = findFilteredObject(packet.threshold);
+                latencyMark(STAGE_BLOB);
+                publishDetection(detection, packet);
+                //only drawn when the tiles produced the detection, like the search window of predictive tracking
+                static thread_local std::string label;
+                char text[32];
+                snprintf(text, sizeof(text), "Tiles skipped %d%%", (int)(100*tileDetector.lastFrame().skippedFraction() + 0.5));
+                label.assign(text);
+                putText(packet.cameraFeed,label,cv::Point(0,200),1,1,cv::Scalar(255,255,255),1);
+            }
+            lastTrackedFrame = packet.frameIndex;
+            return true;
+        }
+
+        //filter BGR frame between HSV values and store filtered image to threshold matrix.
+        //the BGR to HSV conversion is fused into the threshold so no HSV image is written here.
+        hsvThreshold(packet.cameraFeed, currentHSVRange(), packet.threshold);
+        latencyMark(STAGE_THRESHOLD);
+
+        //perform morphological operations on thresholded image to eliminate noise and emphasize the filtered object(s)
+        if(useMorphOps){
+            morphOps(packet.threshold);
+            latencyMark(STAGE_MORPH);
+        }
+
+        //search the thresholded frame for the object. Results are published to the flight controller in frame order,
+        //so publishing is serialized, and a worker that finishes an older frame after a newer one skips it.
+        if(trackObjects){
+            Detection detection = findFilteredObject(packet.threshold);
+            latencyMark(STAGE_BLOB);
+            std::lock_guard<std::mutex> lock(trackerMutex);
+            if (packet.frameIndex <= lastTrackedFrame){return false;}
+            latencySkip();
+            publishDetection(detection, packet);
+            lastTrackedFrame = packet.frameIndex;
+        }
+        return true;
+    }
+
+    /// Hand a detection to the flight controller, then draw it. Called with trackerMutex held, which makes
+    /// this the single writer the output channel needs.
+    void publishDetection(const Detection &detection, FramePacket &packet){
+        output.publish(controlSample(detection, packet.frameIndex, packet.captureTime, packet.cameraFeed.size()));
+        latencyRecord(STAGE_DECISION, latencyClock() - packet.captureTime);
+        reportDetection(detection, x, y, packet.cameraFeed);
+        latencyMark(STAGE_OVERLAY);
+    }
+
+    /// Feed the gate sightings to the race timing, stamped with the frame's capture time. Workers finish
+    /// frames out of order, so the samples wait in timingOrder and reach the timing in capture order.
+    void updateTiming(const FramePacket &packet){
+        GateSample sample;
+        sample.frameIndex = packet.frameIndex;
+        sample.captureTime = packet.captureTime;
+        sample.numGates = (int)std::min(packet.gateDetections.size(), (size_t)MAX_TARGETS);
+        for (int t = 0; t < sample.numGates; t++){sample.found[t] = packet.gateDetections[t].found;}
+        std::lock_guard<std::mutex> lock(timingMutex);
+        timingOrder.add(packet.frameIndex, sample);
+        observeGateSamples();
+    }
+    /// A frame that never reaches updateTiming(): dropped before detection, skipped while paused, or without gates.
+    void skipTiming(long frameIndex){
+        std::lock_guard<std::mutex> lock(timingMutex);
+        timingOrder.skip(frameIndex);
+        observeGateSamples();
+    }
+    /// Hand every sample that is next in capture order to the race timing. Called with timingMutex held.
+    void observeGateSamples(){
+        GateSample sample;
+        while (timingOrder.next(sample)){
+            //gate 1 is the start/finish line, the others are checkpoints
+            for (int t = 0; t < sample.numGates; t++){
+                bool crossed = timing.observe(0, t, sample.found[t], sample.captureTime);
+                if (crossed && recorder){
+                    //a start/finish crossing closes the lap just completed, a checkpoint belongs to the lap in progress
+                    PilotSummary crossing = timing.summary(0);
+                    int lap = t == 0 ? crossing.lapsCompleted : crossing.lapsCompleted + 1;
+                    recorder->requestReplay(sample.frameIndex, sample.captureTime, lap, t);
+                }
+            }
+        }
+    }
+
+    /// Draw the current lap, last and best lap times on the feed.
+    void drawTiming(FramePacket &packet){
+        PilotSummary pilot = timing.summary(0);
+        cv::Scalar color = cv::Scalar(255,255,255);
+        int bottom = packet.cameraFeed.rows;
+        static const std::string waiting = "Waiting for start/finish gate";
+        if (!pilot.started){
+            putText(packet.cameraFeed,waiting,cv::Point(0,bottom-20),2,1,color,2);
+            return;
+        }
+        //the labels are formatted into a string each worker keeps, so drawing them does not allocate
+        static thread_local std::string label;
+        char text[64];
+        snprintf(text, sizeof(text), "Lap %d  %s", pilot.lapsCompleted + 1, formatLapTime(packet.captureTime - pilot.currentLapStart).c_str());
+        label.assign(text);
+        putText(packet.cameraFeed,label,cv::Point(0,bottom-80),2,1,color,2);
+        snprintf(text, sizeof(text), "Last %s", formatLapTime(pilot.lastLap).c_str());
+        label.assign(text);
+        putText(packet.cameraFeed,label,cv::Point(0,bottom-50),2,1,color,2);
+        snprintf(text, sizeof(text), "Best %s", formatLapTime(pilot.bestLap).c_str());
+        label.assign(text);
+        putText(packet.cameraFeed,label,cv::Point(0,bottom-20),2,1,color,2);
+    }
+
+    cv::VideoCapture &capture;
+    int numWorkers;
+    bool dropCapturedFrames;
+    FrameQueue<FramePacket*> captureQueue;
+    FrameQueue<FramePacket*> displayQueue;
+    cv::Size poolFrameSize;
+    FramePool pool;
+    FramePacket *shownFrame; // handed to the UI by latestFrame()
+    std::vector<std::thread> threads;
+    std::atomic<bool> running;
+    std::atomic<bool> captureDone;
+    std::atomic<long> frameCount;
+    std::atomic<long> pendingFrames;
+    std::atomic<long> captureDropCount;
+    std::atomic<long> displayDropCount;
+    std::atomic<long> staleFrameCount;
+    std::atomic<long> steadyStateFrames;
+    std::atomic<long> steadyStateAllocationCount;
+    std::atomic<long> bufferReallocationCount;
+
+    std::shared_ptr<const ColorClassifier> gates; // replaced as a whole, read with std::atomic_load
+    /// Gate sightings of one frame, waiting for the frames before it.
+    struct GateSample {
+        long frameIndex;
+        double captureTime;
+        int numGates;
+        bool found[MAX_TARGETS];
+    };
+    std::mutex timingMutex;
+    FrameSequencer<GateSample> timingOrder; // every captured frame is added or skipped exactly once
+
+    mutable std::mutex trackerMutex;
+    RoiTracker roiTracker;
+    TileChangeDetector tileDetector;
+    int x, y; //x and y values for the location of the object
+    long lastTrackedFrame;
+};
+
+/// Frame counts and the per-stage latency table of a pipeline.
+void writePipelineReport(std::ostream &out, const TrackingPipeline &pipeline){
+    out << "Frames captured " << pipeline.capturedFrames() << ", dropped before detection " << pipeline.captureDrops()
+        << ", dropped before display " << pipeline.displayDrops() << ", stale " << pipeline.staleFrames() << std::endl;
+    if (pipeline.recorder){
+        RecorderStats recording = pipeline.recorder->stats();
+        char line[160];
+        snprintf(line, sizeof(line), "Recorder: %ld frames, %ld dropped, %ld recorded, replay %.1f s in %.0f MB, clips %ld written %ld failed",
+                 recording.submitted, recording.dropped, recording.recorded, recording.replaySeconds, recording.replayMegabytes,
+                 recording.clipsWritten, recording.clipsFailed);
+        out << line << std::endl;
+    }
+    TileStats tiles = pipeline.tileStats();
+    if (tiles.frames > 0){
+        out << "Tile skipping: " << tiles.frames << " frames, " << (int)(100*tiles.skippedFraction() + 0.5) << "% of tiles skipped" << std::endl;
+    }
+    writeLatencyReport(out);
+}
+
+/// Load profileFile and take over its object thresholds. False when there is no usable profile.
+bool loadProfile(CalibrationProfile &profile){
+    if (profileFile.empty()){return false;}
+    double start = latencyClock();
+    std::string error;
+    if (!loadCalibrationProfile(profileFile, profile, error)){
+        std::cerr << "Calibration profile " << profileFile << ": " << error << std::endl;
+        return false;
+    }
+    H_MIN = profile.object.hMin; H_MAX = profile.object.hMax;
+    S_MIN = profile.object.sMin; S_MAX = profile.object.sMax;
+    V_MIN = profile.object.vMin; V_MAX = profile.object.vMax;
+    lockHSVThreshold = true;
+    std::cout << "Loaded calibration profile " << profileFile << " (" << (profile.gates ? profile.gates->numTargets() : 0)
+              << " gates) in " << (latencyClock() - start)*1000 << " ms" << std::endl;
+    return true;
+}
+
+/// Save the current thresholds and the pipeline's gate targets to profileFile, when one is set.
+void saveProfile(const TrackingPipeline &pipeline){
+    if (profileFile.empty()){return;}
+    std::shared_ptr<const ColorClassifier> gates = pipeline.gateTargets();
+    if (!saveCalibrationProfile(profileFile, currentHSVRange(), gates.get())){
+        std::cerr << "Cannot save calibration profile " << profileFile << std::endl;
+    }
+}
+
+/// Interactive tracker. With a profile the object picture is skipped and its gates are tracked from the first frame.
+int colorRecognition(const CalibrationProfile *profile){
 // Originally by Kyle Hounslow 2013.
 // Heavy modifications by E. Schnipke - Feb. 5th, 2014.
 	// program control character.
-    char k;
+    char k = 0;
     bool feedToggle = false;
     bool histToggle = false;
+    int numGates = 0;
+    double lastHistogramDraw = 0;
+    double lastLatencyReport = latencyClock();
+    std::ofstream latencyLogFile;
+    long lastShownFrame = -1;
+    double lastShownTime = 0;
     
-    //boolean variables to toggle object tracking and morphological operations.
-    bool trackObjects = true;
-    bool useMorphOps = true;
-    
-	//Matrix to store each frame of the webcam feed, HSV image, and binary threshold image
-	cv::Mat cameraFeed, HSV, threshold;
-    
-	//x and y values for the location of the object
-	int x=0, y=0;
+	//processed frame handed over by the detection stage
+	FramePacket *packet;
     
 	//video capture object to acquire webcam feed
 	cv::VideoCapture capture;
@@ -383,22 +701,59 @@ int colorRecognition(){
     if(fromCamera){
         capture.open(0);
     }else{
-        capture.open("/Users/Swanson/Downloads/Object Recognition%2C Flight 2.mp4");
+        capture.open(videoFile);
     }
 
 	//set height and width of capture frame
 	capture.set(CV_CAP_PROP_FRAME_WIDTH,FRAME_WIDTH);
 	capture.set(CV_CAP_PROP_FRAME_HEIGHT,FRAME_HEIGHT);
     
-    // take picture of object
-    objectInitialization(capture, false);
+    // take picture of object, unless a calibration profile already has its thresholds
+    if (!profile){
+        objectInitialization(capture, false);
+    }
     
-	//start an infinite loop where webcam feed is copied to cameraFeed matrix.  all of our operations will be performed within this loop
+    // capture and detection run on their own threads. a live camera drops stale frames, a file is processed completely.
+    int numWorkers = std::max(1, (int)std::thread::hardware_concurrency() - 2);
+    TrackingPipeline pipeline(capture, numWorkers, fromCamera);
+    pipeline.decimation = initialDecimation;
+    pipeline.tileSkipping = initialTileSkipping;
+    if (profile){
+        pipeline.setGates(profile->gates);
+        numGates = profile->gates ? profile->gates->numTargets() : 0;
+    }else{
+        saveProfile(pipeline);
+    }
+    setLatencyInstrumentation(latencyStats);
+    if (!controlShm.empty() && !pipeline.output.openSharedMemory(controlShm)){
+        std::cerr << "Cannot publish to shared memory " << controlShm << std::endl;
+    }
+    if (controlUdpPort > 0 && !pipeline.output.openUdp(controlUdpHost, controlUdpPort)){
+        std::cerr << "Cannot send to " << controlUdpHost << ":" << controlUdpPort << std::endl;
+    }
+    if (latencyStats && !latencyLog.empty()){
+        latencyLogFile.open(latencyLog.c_str(), std::ios::app);
+        if (!latencyLogFile){std::cerr << "Cannot open latency log " << latencyLog << std::endl;}
+    }
+    //the recorder encodes on its own threads and drops frames rather than hold up the workers
+    FeedRecorder recorder(recorderOptions);
+    if (!recorderOptions.recordFile.empty() || recorderOptions.replaySeconds > 0){
+        if (recorder.start(pipeline.frameSize())){
+            pipeline.recorder = &recorder;
+        }else{
+            std::cerr << "Cannot record to " << recorderOptions.recordFile << std::endl;
+        }
+    }
+    pipeline.start();
+    
+	//UI loop: show the newest processed frame and handle keystrokes. detection never waits on this loop.
 	while(k != 'q'){
         // toggle which frames to show
         switch (k) {
             case '1':// pause execution
+                pipeline.paused = true;
                 cv::waitKey();
+                pipeline.paused = false;
                 break;
             case '2':// show HSV and Binary videofeeds
                 feedToggle = !feedToggle;
@@ -406,54 +761,122 @@ int colorRecognition(){
             case '3': // show BGR and HSV histograms
                 histToggle = !histToggle;
                 break;
-            case '4': // initialize a new object
+            case '4': // initialize a new object. the capture device is handed back to the UI while this runs.
+                pipeline.stop();
                 objectInitialization(capture, true);
+                saveProfile(pipeline);
+                pipeline.start();
+                break;
+            case '5': // toggle predictive region-of-interest tracking
+                pipeline.roiTracking = !pipeline.roiTracking;
+                break;
+            case '6': // register the current thresholds as an additional gate target
+                if (!pipeline.addGate("Gate " + intToString(++numGates), currentHSVRange())){
+                    std::cout << "At most " << MAX_TARGETS << " gate targets can be registered." << std::endl;
+                }else{
+                    saveProfile(pipeline);
+                }
+                break;
+            case '7': // restart race timing
+                pipeline.timing.reset();
+                break;
+            case '8': // cycle the decimation of the full-frame search
+                pipeline.decimation = pipeline.decimation >= 4 ? 1 : pipeline.decimation*2;
+                std::cout << "Detection decimation " << pipeline.decimation << "x" << std::endl;
+                break;
+            case '0': // toggle tile skipping
+                pipeline.tileSkipping = !pipeline.tileSkipping;
+                std::cout << "Tile skipping " << (pipeline.tileSkipping ? "on" : "off") << std::endl;
+                break;
+            case '9': // print the latency report
+                writePipelineReport(std::cout, pipeline);
+                break;
+            case 'r': // save an instant replay clip ending at the frame on screen
+                if (pipeline.recorder && lastShownFrame >= 0){
+                    recorder.requestReplay(lastShownFrame, lastShownTime, pipeline.timing.summary(0).lapsCompleted + 1, -1);
+                }
                 break;
             default:
                 break;
         }
+        pipeline.buildHSV = feedToggle || histToggle;
+        pipeline.buildHistograms = histToggle;
         
-        //store image to matrix
-		capture.read(cameraFeed);
-        //flip(cameraFeed, cameraFeed, 1);
-		//convert frame from BGR to HSV colorspace
-		cv::cvtColor(cameraFeed,HSV,cv::COLOR_BGR2HSV);
-        
-		//filter HSV image between values and store filtered image to threshold matrix
-		cv::inRange(HSV,cv::Scalar(H_MIN,S_MIN,V_MIN),cv::Scalar(H_MAX,S_MAX,V_MAX),threshold);
-        
-		//perform morphological operations on thresholded image to eliminate noise and emphasize the filtered object(s)
-		if(useMorphOps){morphOps(threshold);}
-        
-		//pass in thresholded frame to our object tracking function. This function will return the x and y coordinates of the filtered object
-		if(trackObjects){trackFilteredObject(x,y,threshold,cameraFeed);}
-        
-		//Show videofeeds
-		imshow(windowName,cameraFeed); // BGR videofeed.  This is always shown.
-        if (feedToggle) {
-            imshow(windowName2,threshold); // binary videofeed
-            imshow(windowName1,HSV); // HSV videofeed
-        }else if(!feedToggle){
-            cv::destroyWindow(windowName2);
-            cv::destroyWindow(windowName1);
+        if ((packet = pipeline.latestFrame())){
+            //Show videofeeds
+            double displayStart = latencyClock();
+            imshow(windowName,packet->cameraFeed); // BGR videofeed.  This is always shown.
+            double displayEnd = latencyClock();
+            latencyRecord(STAGE_DISPLAY, displayEnd - displayStart);
+            latencyRecord(STAGE_GLASS_TO_DISPLAY, displayEnd - packet->captureTime);
+            lastShownFrame = packet->frameIndex;
+            lastShownTime = packet->captureTime;
+            if (feedToggle && packet->hasHSV) {
+                imshow(windowName2,packet->threshold); // binary videofeed
+                imshow(windowName1,packet->HSV); // HSV videofeed
+            }else if(!feedToggle){
+                cv::destroyWindow(windowName2);
+                cv::destroyWindow(windowName1);
+            }
+            //Show histograms
+            double now = displayEnd;
+            if (histToggle && packet->hasHistograms) {
+                /// histogram refresh to display threshold values, rate limited since drawing is far slower than counting
+                if (now - lastHistogramDraw >= HISTOGRAM_REFRESH_SECONDS){
+                    showHistogram("BGR Feed Histogram", packet->bgrHistogram, false);
+                    showHistogram("HSV Feed Histogram", packet->hsvHistogram, true);
+                    lastHistogramDraw = now;
+                }
+            }else if(!histToggle){
+                cv::destroyWindow("BGR Feed Histogram");
+                cv::destroyWindow("HSV Feed Histogram");
+            }
+        }else if (pipeline.finished()){
+            break;
         }
-        //Write cameraFeed to 
-        
-        //Show histograms
-        if (histToggle) {
-            /// histogram refresh to display threshold values
-            drawHistogram("BGR Feed Histogram", cameraFeed, false);
-            drawHistogram("HSV Feed Histogram", HSV, true);
-        }else if(!histToggle){
-            cv::destroyWindow("BGR Feed Histogram");
-            cv::destroyWindow("HSV Feed Histogram");
+
+        //periodic latency log: the stage times cover the frames since the previous entry, the frame counts are totals
+        if (latencyLogFile.is_open() && latencyClock() - lastLatencyReport >= latencyLogInterval){
+            time_t wallClock = time(0);
+            char stamp[32];
+            strftime(stamp, sizeof(stamp), "%Y-%m-%d %H:%M:%S", localtime(&wallClock));
+            latencyLogFile << stamp << std::endl;
+            writePipelineReport(latencyLogFile, pipeline);
+            latencyLogFile << std::endl;
+            latencyLogFile.flush();
+            resetLatencyHistograms();
+            lastLatencyReport = latencyClock();
         }
 
-		//delay 30ms so that screen can refresh. image will not appear without this waitKey() command
-		k = cv::waitKey(30);
+		//pump the highgui event loop. frames arrive at camera rate, so this only needs a short wait.
+		k = cv::waitKey(1);
 	}
     
+    pipeline.stop();
     capture.release();
+    //finish the recording and any clips still waiting for their post-roll
+    recorder.stop();
+    if (pipeline.recorder){
+        RecorderStats recording = recorder.stats();
+        std::cout << "Recorded " << recording.recorded << " of " << recording.submitted << " frames (" << recording.dropped
+                  << " dropped), " << recording.clipsWritten << " replay clips" << std::endl;
+    }
+    
+    //debug builds prove the capture and detection threads stopped allocating once warmed up
+    if (allocationCountingEnabled() && pipeline.steadyStateFrameCount() > 0){
+        std::cout << "Heap allocations after warm-up: " << pipeline.steadyStateAllocations() << " in "
+                  << pipeline.steadyStateFrameCount() << " frames, frame buffers reallocated: " << pipeline.bufferReallocations() << std::endl;
+    }
+    
+    //print the lap table of the session
+    std::vector<LapRecord> laps = pipeline.timing.laps(0);
+    for (size_t i = 0; i < laps.size(); i++){
+        std::cout << "Lap " << laps[i].lap << ": " << formatLapTime(laps[i].lapTime);
+        for (size_t c = 0; c < laps[i].splits.size(); c++){
+            std::cout << "  Gate " << c + 2 << " " << (laps[i].splits[c] >= 0 ? formatLapTime(laps[i].splits[c]) : "-");
+        }
+        std::cout << std::endl;
+    }
 	return 0;
 }
 
@@ -461,6 +884,147 @@ int main(int argc, char* argv[]){
 // Originally by E. Schnipke - Feb 6th, 2014.
 // This program provides flight directives to a target tracking UAV drone.  The program acquires a target and returns whether yaw or pitch are necessary in order to center the target in the frame.
     
-    colorRecognition();
+    bool batch = false;
+    BatchOptions batchOptions;
+    MultiCameraOptions cameraOptions;
+    bool rangeGiven = false;
+    std::vector<size_t> camerasWithoutRange;
+    for (int i = 1; i < argc; i++){
+        std::string arg = argv[i];
+        if (arg == "--batch"){
+            batch = true;
+        }else if (arg == "--file" && i + 1 < argc){
+            fromCamera = false;
+            videoFile = argv[++i];
+        }else if (arg == "--hsv" && i + 1 < argc){
+            HSVRange &r = batchOptions.range;
+            if (sscanf(argv[++i], "%d,%d,%d,%d,%d,%d", &r.hMin, &r.hMax, &r.sMin, &r.sMax, &r.vMin, &r.vMax) != 6){
+                std::cerr << "--hsv expects hMin,hMax,sMin,sMax,vMin,vMax" << std::endl;
+                return 1;
+            }
+            rangeGiven = true;
+        }else if (arg == "--threads" && i + 1 < argc){
+            batchOptions.threads = atoi(argv[++i]);
+        }else if (arg == "--output" && i + 1 < argc){
+            batchOptions.output = argv[++i];
+        }else if (arg == "--no-morph"){
+            batchOptions.useMorphOps = false;
+        }else if (arg == "--roi"){
+            batchOptions.roiTracking = true;
+        }else if (arg == "--decimate" && i + 1 < argc){
+            initialDecimation = std::max(1, std::min(atoi(argv[++i]), MAX_DECIMATION));
+            batchOptions.decimation = initialDecimation;
+        }else if (arg == "--tiles"){
+            initialTileSkipping = true;
+            batchOptions.tileSkipping = true;
+        }else if (arg == "--latency-log" && i + 1 < argc){
+            latencyLog = argv[++i];
+        }else if (arg == "--latency-interval" && i + 1 < argc){
+            latencyLogInterval = std::max(1.0, atof(argv[++i]));
+        }else if (arg == "--no-latency"){
+            latencyStats = false;
+        }else if (arg == "--control-shm" && i + 1 < argc){
+            controlShm = argv[++i];
+        }else if (arg == "--no-control-shm"){
+            controlShm.clear();
+        }else if (arg == "--record" && i + 1 < argc){
+            recorderOptions.recordFile = argv[++i];
+        }else if (arg == "--replay-seconds" && i + 1 < argc){
+            recorderOptions.replaySeconds = std::max(0.0, atof(argv[++i]));
+        }else if (arg == "--replay-mb" && i + 1 < argc){
+            recorderOptions.replayMegabytes = std::max(1.0, atof(argv[++i]));
+        }else if (arg == "--clip-prefix" && i + 1 < argc){
+            recorderOptions.clipPrefix = argv[++i];
+        }else if (arg == "--control-udp" && i + 1 < argc){
+            char host[64];
+            if (sscanf(argv[++i], "%63[^:]:%d", host, &controlUdpPort) != 2){
+                std::cerr << "--control-udp expects host:port" << std::endl;
+                return 1;
+            }
+            controlUdpHost = host;
+        }else if (arg == "--target" && i + 1 < argc){
+            ColorTarget target;
+            HSVRange &r = target.range;
+            char name[64];
+            if (sscanf(argv[++i], "%63[^:]:%d,%d,%d,%d,%d,%d", name, &r.hMin, &r.hMax, &r.sMin, &r.sMax, &r.vMin, &r.vMax) != 7){
+                std::cerr << "--target expects name:hMin,hMax,sMin,sMax,vMin,vMax" << std::endl;
+                return 1;
+            }
+            target.name = name;
+            batchOptions.targets.push_back(target);
+        }else if (arg == "--camera" && i + 1 < argc){
+            // the input may itself contain ':', the thresholds (if any) are after the last one
+            std::string spec = argv[++i];
+            size_t nameEnd = spec.find(':'), rangeStart = spec.rfind(':');
+            CameraSource source;
+            HSVRange &r = source.range;
+            if (nameEnd == std::string::npos || nameEnd == 0){
+                std::cerr << "--camera expects name:input[:hMin,hMax,sMin,sMax,vMin,vMax]" << std::endl;
+                return 1;
+            }
+            source.name = spec.substr(0, nameEnd);
+            if (rangeStart > nameEnd &&
+                sscanf(spec.c_str() + rangeStart + 1, "%d,%d,%d,%d,%d,%d", &r.hMin, &r.hMax, &r.sMin, &r.sMax, &r.vMin, &r.vMax) == 6){
+                source.input = spec.substr(nameEnd + 1, rangeStart - nameEnd - 1);
+            }else{
+                source.input = spec.substr(nameEnd + 1);
+                camerasWithoutRange.push_back(cameraOptions.sources.size());
+            }
+            cameraOptions.sources.push_back(source);
+        }else if (arg == "--realtime"){
+            cameraOptions.realtime = true;
+        }else if (arg == "--seconds" && i + 1 < argc){
+            cameraOptions.seconds = std::max(0.0, atof(argv[++i]));
+        }else if (arg == "--scaling"){
+            cameraOptions.scaling = true;
+        }else if (arg == "--profile" && i + 1 < argc){
+            profileFile = argv[++i];
+        }else if (!arg.empty() && arg[0] != '-'){
+            batchOptions.inputs.push_back(arg);
+        }else{
+            std::cerr << "Unknown option " << arg << std::endl;
+            return 1;
+        }
+    }
+    
+    CalibrationProfile profile;
+    bool haveProfile = loadProfile(profile);
+    
+    if (!cameraOptions.sources.empty()){
+        // cameras without thresholds track the profile gate of their name, or the profile's object
+        for (size_t c = 0; c < camerasWithoutRange.size(); c++){
+            CameraSource &source = cameraOptions.sources[camerasWithoutRange[c]];
+            if (!haveProfile){
+                std::cerr << "--camera " << source.name << " needs thresholds or a --profile" << std::endl;
+                return 1;
+            }
+            source.range = profile.object;
+            for (int t = 0; profile.gates && t < profile.gates->numTargets(); t++){
+                if (profile.gates->target(t).name == source.name){source.range = profile.gates->target(t).range;}
+            }
+        }
+        cameraOptions.threads = batchOptions.threads;
+        cameraOptions.useMorphOps = batchOptions.useMorphOps;
+        cameraOptions.roiTracking = batchOptions.roiTracking;
+        cameraOptions.decimation = batchOptions.decimation;
+        cameraOptions.tileSkipping = batchOptions.tileSkipping;
+        return runMultiCamera(cameraOptions);
+    }
+    if (batch){
+        if (batchOptions.inputs.empty()){
+            std::cerr << "--batch needs at least one video file" << std::endl;
+            return 1;
+        }
+        // what the command line leaves open comes from the profile, its gate table included
+        if (haveProfile){
+            if (!rangeGiven){batchOptions.range = profile.object;}
+            if (batchOptions.targets.empty() && profile.gates){
+                for (int t = 0; t < profile.gates->numTargets(); t++){batchOptions.targets.push_back(profile.gates->target(t));}
+                batchOptions.classifier = profile.gates;
+            }
+        }
+        return runBatch(batchOptions);
+    }
+    colorRecognition(haveProfile ? &profile : 0);
     return 0;
 }
@@ -0,0 +1,386 @@
+#include "multiCameraTracker.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <deque>
+#include <iostream>
+#include <mutex>
+#include <thread>
+#include "openCVCompat.h"
+#include "framePool.h"
+#include "frameSequencer.h"
+#include "latencyStats.h"
+#include "pyramidDetector.h"
+#include "roiTracker.h"
+
+//frames a source may have in flight per pool worker, on top of the one being captured
+const int FRAMES_PER_WORKER = 1;
+//frame rate assumed for files that do not report one
+const double DEFAULT_FILE_FPS = 30;
+
+struct MultiCameraTracker::Source {
+    CameraSource config;
+    int index;
+    MultiCameraTracker *owner;
+    cv::VideoCapture capture;
+    bool isFile;
+    double fps;
+    std::unique_ptr<FramePool> frames;
+    std::thread thread;
+    std::atomic<bool> done;
+    std::atomic<long> inFlight;
+    std::atomic<long> captured, processed, dropped, stale;
+
+    // tracker state, one frame at a time
+    std::mutex mutex;
+    RoiTracker roiTracker;
+    TileChangeDetector tileDetector;
+    long lastTrackedFrame;
+    Detection latest;
+    double latestCaptureTime;
+
+    // timing samples, under the owner's timingMutex
+    FrameSequencer<TimingSample> timingOrder; // every captured frame is added or skipped exactly once
+    std::deque<TimingSample> ordered;         // in frame order, waiting for the other sources to catch up
+    double lastOrdered;                       // capture time of the last sample that left timingOrder
+    bool ended;                               // done, and every captured frame left timingOrder
+
+    Source(): index(0), owner(0), isFile(false), fps(0), done(false), inFlight(0),
+              captured(0), processed(0), dropped(0), stale(0), lastTrackedFrame(-1), latestCaptureTime(0),
+              lastOrdered(-1e300), ended(false) {}
+};
+
+static bool isDeviceNumber(const std::string &input){
+    return !input.empty() && input.find_first_not_of("0123456789") == std::string::npos;
+}
+
+MultiCameraTracker::MultiCameraTracker(const MultiCameraOptions &options)
+: timing((int)std::max<size_t>(1, options.sources.size())), settings(options), pool(options.threads),
+  running(false), startClock(0), newestSample(-1e300) {
+    for (size_t i = 0; i < options.sources.size(); i++){
+        sources.push_back(std::unique_ptr<Source>(new Source));
+        sources.back()->config = options.sources[i];
+        sources.back()->index = (int)i;
+        sources.back()->owner = this;
+    }
+}
+
+MultiCameraTracker::~MultiCameraTracker(){
+    stop();
+}
+
+bool MultiCameraTracker::start(){
+    if (running){return true;}
+    for (size_t i = 0; i < sources.size(); i++){
+        Source &s = *sources[i];
+        s.isFile = !isDeviceNumber(s.config.input);
+        if (s.isFile){
+            s.capture.open(s.config.input);
+        }else{
+            s.capture.open(atoi(s.config.input.c_str()));
+            s.capture.set(CV_CAP_PROP_FRAME_WIDTH, FRAME_WIDTH);
+            s.capture.set(CV_CAP_PROP_FRAME_HEIGHT, FRAME_HEIGHT);
+        }
+        if (!s.capture.isOpened()){
+            std::cerr << "Cannot open " << s.config.name << " (" << s.config.input << ")" << std::endl;
+            for (size_t j = 0; j <= i; j++){sources[j]->capture.release();}
+            return false;
+        }
+        s.fps = s.capture.get(CV_CAP_PROP_FPS);
+        if (!(s.fps > 0)){s.fps = DEFAULT_FILE_FPS;}
+        cv::Size size((int)s.capture.get(CV_CAP_PROP_FRAME_WIDTH), (int)s.capture.get(CV_CAP_PROP_FRAME_HEIGHT));
+        if (size.width <= 0 || size.height <= 0){size = cv::Size(FRAME_WIDTH, FRAME_HEIGHT);}
+        s.frames.reset(new FramePool(pool.numThreads()*FRAMES_PER_WORKER + 1, size));
+        s.done = false;
+        s.lastTrackedFrame = -1;
+        s.roiTracker.reset();
+        s.roiTracker.setDecimation(settings.decimation);
+        s.tileDetector.reset();
+        s.tileDetector.resetStats();
+        s.timingOrder.reset(0);
+        s.ordered.clear();
+        s.lastOrdered = -1e300;
+        s.ended = false;
+    }
+    newestSample = -1e300;
+    running = true;
+    startClock = latencyClock();
+    for (size_t i = 0; i < sources.size(); i++){
+        sources[i]->thread = std::thread(&MultiCameraTracker::captureLoop, this, std::ref(*sources[i]));
+    }
+    return true;
+}
+
+void MultiCameraTracker::stop(){
+    if (!running){return;}
+    running = false;
+    for (size_t i = 0; i < sources.size(); i++){
+        if (sources[i]->thread.joinable()){sources[i]->thread.join();}
+    }
+    //frames already handed to the pool still return to their source's FramePool
+    pool.wait();
+    for (size_t i = 0; i < sources.size(); i++){sources[i]->capture.release();}
+    //every frame is in, the samples still held for a source that did not catch up go to the timing now
+    std::lock_guard<std::mutex> lock(timingMutex);
+    mergeSamples(true);
+}
+
+bool MultiCameraTracker::finished() const {
+    for (size_t i = 0; i < sources.size(); i++){
+        if (!sources[i]->done || sources[i]->inFlight > 0){return false;}
+    }
+    return true;
+}
+
+const CameraSource &MultiCameraTracker::source(int index) const {
+    return sources[index]->config;
+}
+
+CameraStats MultiCameraTracker::stats(int index) const {
+    Source &s = *sources[index];
+    CameraStats result;
+    result.captured = s.captured;
+    result.processed = s.processed;
+    result.dropped = s.dropped;
+    result.stale = s.stale;
+    std::lock_guard<std::mutex> lock(s.mutex);
+    result.latest = s.latest;
+    result.latestCaptureTime = s.latestCaptureTime;
+    result.tiles = s.tileDetector.total();
+    return result;
+}
+
+void MultiCameraTracker::captureLoop(Source &s){
+    long frameIndex = 0;
+    // a file keeps every frame unless it plays in real time, a camera never waits for the workers
+    bool waitForWorkers = s.isFile && !settings.realtime;
+    while (running){
+        double frameTime = startClock + frameIndex/s.fps;
+        if (s.isFile && settings.realtime){
+            double wait = frameTime - latencyClock();
+            if (wait > 0){std::this_thread::sleep_for(std::chrono::microseconds((long)(wait*1e6)));}
+        }
+        FramePacket *packet = s.frames->acquire();
+        if (!packet){
+            if (waitForWorkers){
+                std::this_thread::yield();
+                continue;
+            }
+            // every buffer is busy: take the frame off the device so the next one is fresh, and skip it
+            if (!s.capture.grab()){break;}
+            s.captured++;
+            s.dropped++;
+            sequenceSample(s, frameIndex++, 0);
+            continue;
+        }
+        if (!s.capture.read(packet->cameraFeed) || packet->cameraFeed.empty()){
+            s.frames->release(packet);
+            break;
+        }
+        packet->captureTime = s.isFile ? frameTime : latencyClock();
+        packet->frameIndex = frameIndex++;
+        s.captured++;
+        s.inFlight++;
+        if (!pool.submit(&MultiCameraTracker::processFrame, &s, packet)){
+            s.inFlight--;
+            s.dropped++;
+            sequenceSample(s, packet->frameIndex, 0);
+            s.frames->release(packet);
+        }
+    }
+    s.done = true;
+    //the others no longer wait for this source once its last frames are in
+    sequenceSample(s, -1, 0);
+}
+
+void MultiCameraTracker::recordDetection(Source &s, const FramePacket &packet, const Detection &detection){
+    s.lastTrackedFrame = packet.frameIndex;
+    s.latest = detection;
+    s.latestCaptureTime = packet.captureTime;
+}
+
+void MultiCameraTracker::sequenceSample(Source &s, long frameIndex, const TimingSample *sample){
+    std::lock_guard<std::mutex> lock(timingMutex);
+    if (frameIndex >= 0){
+        if (sample){
+            s.timingOrder.add(frameIndex, *sample);
+            newestSample = std::max(newestSample, sample->captureTime);
+        }else{
+            s.timingOrder.skip(frameIndex);
+        }
+    }
+    TimingSample next;
+    while (s.timingOrder.next(next)){
+        s.ordered.push_back(next);
+        s.lastOrdered = next.captureTime;
+    }
+    s.ended = s.done && s.timingOrder.nextFrame() >= s.captured;
+    mergeSamples(false);
+}
+
+void MultiCameraTracker::mergeSamples(bool flush){
+    for (;;){
+        // earliest held sample of any source
+        Source *first = 0;
+        for (size_t i = 0; i < sources.size(); i++){
+            Source &s = *sources[i];
+            if (!s.ordered.empty() && (!first || s.ordered.front().captureTime < first->ordered.front().captureTime)){first = &s;}
+        }
+        if (!first){return;}
+        const TimingSample &sample = first->ordered.front();
+        // a later sample of another source must not already be waiting behind a frame it has not delivered yet
+        // every other source must have passed its capture time: a source with samples held has (they are later),
+        // an ended one will not deliver anything earlier. a source that went silent is waited for up to the window.
+        bool ready = flush || sample.captureTime < newestSample - MERGE_WINDOW_SECONDS;
+        if (!ready){
+            ready = true;
+            for (size_t i = 0; i < sources.size(); i++){
+                const Source &s = *sources[i];
+                if (&s != first && s.ordered.empty() && !s.ended && s.lastOrdered < sample.captureTime){ready = false;}
+            }
+        }
+        if (!ready){return;}
+        timing.observe(0, first->index, sample.present, sample.captureTime);
+        first->ordered.pop_front();
+    }
+}
+
+void MultiCameraTracker::processFrame(void *context, void *item){
+    Source &s = *static_cast<Source*>(context);
+    FramePacket &packet = *static_cast<FramePacket*>(item);
+    const MultiCameraOptions &options = s.owner->settings;
+    const HSVRange &range = s.config.range;
+
+    Detection detection;
+    bool searched = false;
+    // like the interactive tracker: predictive tracking first, then coarse-to-fine, then tile skipping
+    bool tiled = !options.roiTracking && options.decimation <= 1 && options.tileSkipping;
+    bool inOrder = options.roiTracking || tiled;
+    if (inOrder){
+        // the prediction and the tile masks need this source's frames in order, so the whole search runs under its lock
+        std::lock_guard<std::mutex> lock(s.mutex);
+        if (packet.frameIndex > s.lastTrackedFrame){
+            if (options.roiTracking){
+                detection = s.roiTracker.detect(packet.cameraFeed, range, options.useMorphOps, packet.frameIndex);
+            }else{
+                s.tileDetector.threshold(packet.cameraFeed, range, options.useMorphOps, packet.threshold);
+                detection = findFilteredObject(packet.threshold);
+            }
+            recordDetection(s, packet, detection);
+            searched = true;
+        }
+    }
+    if (!searched){
+        // a frame that lost the race to a newer one is still searched, on its own, for the race timing
+        if (options.decimation > 1){
+            static thread_local PyramidDetector pyramid;
+            pyramid.setDecimation(options.decimation);
+            detection = pyramid.detect(packet.cameraFeed, range, options.useMorphOps);
+        }else{
+            hsvThreshold(packet.cameraFeed, range, packet.threshold);
+            if (options.useMorphOps){morphOps(packet.threshold);}
+            detection = findFilteredObject(packet.threshold);
+        }
+        // results go in in capture order, a frame that lost the race to a newer one is left out of them
+        std::lock_guard<std::mutex> lock(s.mutex);
+        if (inOrder || packet.frameIndex <= s.lastTrackedFrame){
+            s.stale++;
+        }else{
+            recordDetection(s, packet, detection);
+        }
+    }
+    TimingSample sample = {packet.captureTime, detection.found};
+    s.owner->sequenceSample(s, packet.frameIndex, &sample);
+    s.processed++;
+    s.frames->release(&packet);
+    s.inFlight--;
+}
+
+namespace {
+
+/// Run the tracker until its files end or seconds have passed. Returns the elapsed time in seconds.
+double runUntilDone(MultiCameraTracker &tracker, double seconds){
+    double start = latencyClock();
+    while (!tracker.finished() && (seconds <= 0 || latencyClock() - start < seconds)){
+        std::this_thread::sleep_for(std::chrono::milliseconds(20));
+    }
+    double elapsed = latencyClock() - start;
+    tracker.stop();
+    return elapsed;
+}
+
+long processedFrames(const MultiCameraTracker &tracker){
+    long total = 0;
+    for (int i = 0; i < tracker.numSources(); i++){total += tracker.stats(i).processed;}
+    return total;
+}
+
+int runScaling(const MultiCameraOptions &options){
+    for (size_t i = 0; i < options.sources.size(); i++){
+        if (isDeviceNumber(options.sources[i].input)){
+            std::cerr << "--scaling replays files, " << options.sources[i].name << " is a camera" << std::endl;
+            return 1;
+        }
+    }
+    int cores = std::max(1, (int)std::thread::hardware_concurrency());
+    std::vector<int> counts;
+    for (int n = 1; n < cores; n *= 2){counts.push_back(n);}
+    counts.push_back(cores);
+
+    double baseline = 0;
+    printf("%8s %10s %8s %8s\n", "workers", "fps", "speedup", "stolen");
+    for (size_t c = 0; c < counts.size(); c++){
+        MultiCameraOptions run = options;
+        run.threads = counts[c];
+        run.realtime = false;
+        MultiCameraTracker tracker(run);
+        if (!tracker.start()){return 1;}
+        double elapsed = runUntilDone(tracker, run.seconds);
+        double fps = elapsed > 0 ? processedFrames(tracker)/elapsed : 0;
+        if (c == 0){baseline = fps;}
+        printf("%8d %10.1f %7.2fx %8ld\n", counts[c], fps, baseline > 0 ? fps/baseline : 0, tracker.workers().stolenTasks());
+    }
+    return 0;
+}
+
+} // namespace
+
+int runMultiCamera(const MultiCameraOptions &options){
+    if (options.sources.empty()){
+        std::cerr << "No camera sources given" << std::endl;
+        return 1;
+    }
+    if (options.scaling){return runScaling(options);}
+
+    MultiCameraTracker tracker(options);
+    if (!tracker.start()){return 1;}
+    std::cout << tracker.numSources() << " sources on " << tracker.workers().numThreads() << " workers" << std::endl;
+    double elapsed = runUntilDone(tracker, options.seconds);
+
+    for (int i = 0; i < tracker.numSources(); i++){
+        CameraStats s = tracker.stats(i);
+        char line[200];
+        int n = snprintf(line, sizeof(line), "%-12s %7ld captured %7ld processed %6ld dropped %6ld stale %8.1f fps",
+                         tracker.source(i).name.c_str(), s.captured, s.processed, s.dropped, s.stale, elapsed > 0 ? s.processed/elapsed : 0);
+        if (options.tileSkipping && !options.roiTracking && options.decimation <= 1 && n > 0 && n < (int)sizeof(line)){
+            snprintf(line + n, sizeof(line) - n, " %5.1f%% tiles skipped", 100*s.tiles.skippedFraction());
+        }
+        std::cout << line << std::endl;
+    }
+    std::cout << processedFrames(tracker) << " frames in " << elapsed << " s, " << tracker.workers().stolenTasks()
+              << " of " << tracker.workers().executedTasks() << " tasks stolen" << std::endl;
+
+    // source 0 is the start/finish line, the others are checkpoints
+    std::vector<LapRecord> laps = tracker.timing.laps(0);
+    for (size_t l = 0; l < laps.size(); l++){
+        std::cout << "  lap " << laps[l].lap << ": " << formatLapTime(laps[l].lapTime);
+        for (size_t c = 0; c < laps[l].splits.size(); c++){
+            std::cout << "  " << tracker.source((int)c + 1).name << " "
+                      << (laps[l].splits[c] >= 0 ? formatLapTime(laps[l].splits[c]) : "-");
+        }
+        std::cout << std::endl;
+    }
+    return 0;
+}
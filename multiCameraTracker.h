@@ -0,0 +1,128 @@
+/***************************************
+ Tracking several cameras at once, one per gate.
+
+ Each source (a camera device or a video file played back as a simulated
+ camera) has its own capture thread, thresholds, frame pool and tracker
+ state. Captured frames become tasks on one work-stealing pool shared by
+ every source and sized to the core count, so a busy gate borrows workers
+ from quiet ones. Detection runs with no shared state between sources,
+ which is what lets throughput grow with the number of cores.
+
+ All sources timestamp their frames on one clock. Cameras are stamped with
+ latencyClock() right after the frame is read. Files are stamped with the
+ tracker's start time plus the frame's position in the video, so files
+ recorded in sync stay in sync however fast they decode. Source i is
+ checkpoint i of the race timing, source 0 being the start/finish line.
+
+ Every frame, including one that lost the race to a newer frame of its
+ source, yields a timing sample. The race timing sees them in capture-time
+ order across all sources: each source's samples are put back into frame
+ order, and a sample is only observed once every other source has passed
+ its capture time (or ended). A source that stops delivering holds the
+ others back by at most MERGE_WINDOW_SECONDS.
+ ************************************/
+
+#ifndef MULTI_CAMERA_TRACKER_H
+#define MULTI_CAMERA_TRACKER_H
+
+#include <atomic>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+#include "hsvThreshold.h"
+#include "objectTracking.h"
+#include "raceTiming.h"
+#include "tileChangeDetector.h"
+#include "workStealingPool.h"
+
+struct FramePacket;
+
+//how far the newest timing sample may run ahead of one still waiting for a silent source, seconds
+const double MERGE_WINDOW_SECONDS = 1.0;
+
+struct CameraSource {
+    std::string name;
+    std::string input; // camera device number, or a video file
+    HSVRange range;
+};
+
+struct MultiCameraOptions {
+    std::vector<CameraSource> sources;
+    int threads;       // pool workers, 0 = one per core
+    bool realtime;     // play files at their recorded frame rate instead of as fast as they decode
+    double seconds;    // stop after this long, 0 = when every file has ended
+    bool useMorphOps;
+    bool roiTracking;  // predictive window search, serializes each source's frames
+    int decimation;    // coarse-to-fine search, 1 = full resolution
+    bool scaling;      // run the files with 1, 2, 4 ... one per core workers and report the speedup
+    bool tileSkipping; // threshold only the tiles that changed, serializes each source's frames
+    MultiCameraOptions(): threads(0), realtime(false), seconds(0), useMorphOps(true), roiTracking(false), decimation(1), scaling(false),
+                          tileSkipping(false) {}
+};
+
+struct CameraStats {
+    long captured;
+    long processed;
+    long dropped;    // captured frames that never reached a worker: live sources skip frames while every buffer is busy
+    long stale;      // frames finished after a newer frame of the same source, left out of tracking (not of timing)
+    TileStats tiles; // with tile skipping, every frame's tiles so far
+    Detection latest;
+    double latestCaptureTime;
+};
+
+/// Whether a source saw its target in one frame, as the race timing gets it.
+struct TimingSample {
+    double captureTime;
+    bool present;
+};
+
+class MultiCameraTracker {
+public:
+    explicit MultiCameraTracker(const MultiCameraOptions &options);
+    ~MultiCameraTracker();
+
+    /// Open every source and start capturing. False if a source cannot be opened, nothing runs then.
+    bool start();
+    void stop();
+    /// True once every file has ended and its frames were processed. Never true with a camera source.
+    bool finished() const;
+
+    int numSources() const {return (int)sources.size();}
+    const CameraSource &source(int index) const;
+    CameraStats stats(int index) const;
+    /// Time every timestamp is measured from, on latencyClock().
+    double startTime() const {return startClock;}
+    const WorkStealingPool &workers() const {return pool;}
+
+    RaceTiming timing; // source i is checkpoint i
+
+private:
+    MultiCameraTracker(const MultiCameraTracker &);
+    MultiCameraTracker &operator=(const MultiCameraTracker &);
+
+    struct Source;
+    static void processFrame(void *context, void *item);
+    /// Take over a detection of source s. Called with s.mutex held, in frame order.
+    static void recordDetection(Source &s, const FramePacket &packet, const Detection &detection);
+    /// Hand the timing sample of frame frameIndex of s over, or skip the frame (sample 0) when it was never processed.
+    void sequenceSample(Source &s, long frameIndex, const TimingSample *sample);
+    /// Observe the held samples that every source has passed, all of them with flush. Called with timingMutex held.
+    void mergeSamples(bool flush);
+    void captureLoop(Source &source);
+
+    MultiCameraOptions settings;
+    WorkStealingPool pool;
+    std::vector<std::unique_ptr<Source> > sources;
+    std::atomic<bool> running;
+    double startClock;
+
+    std::mutex timingMutex; // the sequencers and ordered samples of every source
+    double newestSample;    // latest capture time handed to sequenceSample()
+};
+
+/// Headless front end: track the sources until they end (or for options.seconds) and print per-source
+/// statistics and the lap table, or the scaling table with options.scaling. Returns 0 on success.
+int runMultiCamera(const MultiCameraOptions &options);
+
+#endif
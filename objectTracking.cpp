@@ -0,0 +1,152 @@
+#include "objectTracking.h"
+#include "binaryMorphology.h"
+#include "blobExtractor.h"
+
+#include <cstdio>
+#include <string>
+
+//initial min and max HSV filter values.
+//these will be changed using trackbars
+int H_MIN = 0;
+int H_MAX = 256;
+int S_MIN = 0;
+int S_MAX = 256;
+int V_MIN = 0;
+int V_MAX = 256;
+
+HSVRange currentHSVRange(){
+    HSVRange range = {H_MIN, H_MAX, S_MIN, S_MAX, V_MIN, V_MAX};
+    return range;
+}
+
+std::string intToString(int number){
+// Originally by Kyle Hounslow 2013
+	//formatted without a stringstream, and short enough for the string to stay off the heap
+	char text[16];
+	snprintf(text, sizeof(text), "%d", number);
+	return text;
+}
+void drawObject(int x, int y,cv::Mat &frame){
+// Originally by Kyle Hounslow 2013
+	//use some of the openCV drawing functions to draw crosshairs
+	//on your tracked image!
+    
+    //UPDATE:JUNE 18TH, 2013
+    //added 'if' and 'else' statements to prevent
+    //memory errors from writing off the screen (ie. (-25,-25) is not within the window!)
+    cv::Scalar color = cv::Scalar(0,255,0);
+    
+	circle(frame,cv::Point(x,y),20,color,2);
+    if(y-25>0)
+        line(frame,cv::Point(x,y),cv::Point(x,y-25),color,2);
+    else line(frame,cv::Point(x,y),cv::Point(x,0),color,2);
+    if(y+25<FRAME_HEIGHT)
+        line(frame,cv::Point(x,y),cv::Point(x,y+25),color,2);
+    else line(frame,cv::Point(x,y),cv::Point(x,FRAME_HEIGHT),color,2);
+    if(x-25>0)
+        line(frame,cv::Point(x,y),cv::Point(x-25,y),color,2);
+    else line(frame,cv::Point(x,y),cv::Point(0,y),color,2);
+    if(x+25<FRAME_WIDTH)
+        line(frame,cv::Point(x,y),cv::Point(x+25,y),color,2);
+    else line(frame,cv::Point(x,y),cv::Point(FRAME_WIDTH,y),color,2);
+    
+	putText(frame,intToString(x)+","+intToString(y),cv::Point(x,y+30),1,1,color,2);
+    
+}
+void drawLabelledObject(int x, int y, const std::string &label, cv::Mat &frame){
+    cv::Scalar color = cv::Scalar(0,200,255);
+    circle(frame,cv::Point(x,y),12,color,2);
+    putText(frame,label,cv::Point(x+15,y-15),1,1,color,2);
+}
+void morphOps(cv::Mat &thresh){
+// Originally by Kyle Hounslow 2013
+	//erode twice with a 3px by 3px rectangle to remove noise, then
+    //dilate four times with a larger 8px by 8px rectangle to make sure object is nicely visible.
+    //the six passes are fused into one bit-packed erode and one dilate, with the same result as cv::erode/cv::dilate.
+    //each thread keeps its own working buffers.
+    static thread_local BinaryMorphology morphology;
+    morphology.erodeDilate(thresh, thresh, cv::Size(3,3), 2, cv::Size(8,8), 4);
+}
+void directionToObject(Detection &detection){
+// Yaw and pitch notification by E. Schnipke - Feb. 5th, 2014
+    int yawPadding = 100; // how wide the center yaw area is in pixels
+    int pitchPadding = 100; // how tall the center pitch area is in pixels
+    // whether object is to left of screen, center, or to right of screen
+    if (detection.x<(FRAME_WIDTH - yawPadding)/2) {
+        detection.yaw = -1; //left
+    }else if(detection.x>(FRAME_WIDTH + yawPadding)/2){
+        detection.yaw = 1; //right
+    }else{
+        detection.yaw = 0; //center
+    }
+    // whether object is to the top, center, or bottom of screen
+    if (detection.y<(FRAME_HEIGHT - pitchPadding)/2) {
+        detection.pitch = -1; //bottom
+    }else if(detection.y>(FRAME_HEIGHT + pitchPadding)/2){
+        detection.pitch = 1; //top
+    }else{
+        detection.pitch = 0; //center
+    }
+}
+Detection findFilteredObject(const cv::Mat &threshold, cv::Point offset){
+// Originally by Kyle Hounslow 2013 as part of trackFilteredObject()
+    Detection detection;
+    //label every blob of the filtered image in one sweep. each thread keeps its own working buffers.
+    static thread_local BlobExtractor extractor;
+    const std::vector<Blob> &blobs = extractor.extract(threshold);
+
+    detection.numObjects = (int)blobs.size();
+    //if number of objects greater than MAX_NUM_OBJECTS we have a noisy filter
+    if (detection.numObjects >= MAX_NUM_OBJECTS){
+        detection.tooNoisy = true;
+        return detection;
+    }
+
+    //if the area is less than 10 px by 10px then it is probably just noise
+    //if the area is the same as the 3/2 of the image size, probably just a bad filter
+    //we only want the object with the largest area.
+    int best = -1;
+    for (size_t i = 0; i < blobs.size(); i++){
+        int area = blobs[i].area;
+        if (area>MIN_OBJECT_AREA && area<MAX_OBJECT_AREA && (best < 0 || area>blobs[best].area)){
+            best = (int)i;
+        }
+    }
+    if (best >= 0){
+        const Blob &blob = blobs[best];
+        detection.found = true;
+        detection.area = blob.area;
+        detection.x = (int)(blob.centroidX() + offset.x);
+        detection.y = (int)(blob.centroidY() + offset.y);
+        detection.boundingBox = blob.boundingBox();
+        detection.boundingBox.x += offset.x;
+        detection.boundingBox.y += offset.y;
+        directionToObject(detection);
+    }
+    return detection;
+}
+void reportDetection(const Detection &detection, int &x, int &y, cv::Mat &cameraFeed){
+// Originally by Kyle Hounslow 2013 as part of trackFilteredObject()
+// Yaw and pitch notification by E. Schnipke - Feb. 5th, 2014
+    static const std::string tooNoisy = "TOO MUCH NOISE! ADJUST FILTER";
+    static const std::string tracking = "Tracking Object";
+    if (detection.tooNoisy){
+        putText(cameraFeed,tooNoisy,cv::Point(0,50),1,2,cv::Scalar(0,0,255),2);
+        return;
+    }
+    //let user know you found an object
+    if(detection.found ==true){
+        x = detection.x;
+        y = detection.y;
+        putText(cameraFeed,tracking,cv::Point(0,50),2,1,cv::Scalar(0,255,0),2);
+        putText(cameraFeed, "Yaw = " + intToString(detection.yaw), cv::Point(0,100),2,1,cv::Scalar(0,255,0),2);
+        putText(cameraFeed, "Pitch = " + intToString(detection.pitch), cv::Point(0,150),2,1,cv::Scalar(0,255,0),2);
+        //draw object location on screen
+        drawObject(x,y,cameraFeed);
+    }
+}
+void trackFilteredObject(int &x, int &y, cv::Mat threshold, cv::Mat &cameraFeed){
+// Originally by Kyle Hounslow 2013
+// Yaw and pitch notification by E. Schnipke - Feb. 5th, 2014
+    reportDetection(findFilteredObject(threshold), x, y, cameraFeed);
+}
@@ -0,0 +1,61 @@
+/***************************************
+ Color object detection shared by the interactive tracker and the headless
+ batch mode: HSV threshold bounds, morphological clean-up and blob finding.
+ Nothing in here opens a window.
+ ************************************/
+
+#ifndef OBJECT_TRACKING_H
+#define OBJECT_TRACKING_H
+
+#include <opencv2/opencv.hpp>
+#include <string>
+#include "hsvThreshold.h"
+
+//min and max HSV filter values. these are changed using trackbars and the histogram.
+extern int H_MIN;
+extern int H_MAX;
+extern int S_MIN;
+extern int S_MAX;
+extern int V_MIN;
+extern int V_MAX;
+//default capture width and height
+const int FRAME_WIDTH = 1280;
+const int FRAME_HEIGHT = 720;
+//max number of objects to be detected in frame
+const int MAX_NUM_OBJECTS=50;
+//minimum and maximum object area
+const int MIN_OBJECT_AREA = 10*10;
+const int MAX_OBJECT_AREA = FRAME_HEIGHT*FRAME_WIDTH/1.5;
+
+/// Result of searching one thresholded frame for the filtered object.
+struct Detection {
+    bool found;      // an object of valid size was found
+    bool tooNoisy;   // more than MAX_NUM_OBJECTS blobs, the filter needs adjusting
+    int numObjects;  // number of 8-connected blobs in the frame
+    int x, y;        // centroid of the largest valid blob
+    double area;     // pixel count of the largest valid blob, 0 if there is none
+    cv::Rect boundingBox; // bounding box of the largest valid blob
+    int yaw, pitch;  // -1/0/1 direction to the object, only meaningful when found
+    Detection(): found(false), tooNoisy(false), numObjects(0), x(0), y(0), area(0), yaw(0), pitch(0) {}
+};
+
+/// Current H_MIN..V_MAX trackbar values.
+HSVRange currentHSVRange();
+
+std::string intToString(int number);
+void drawObject(int x, int y,cv::Mat &frame);
+/// Smaller marker with a name, used for the registered gate targets.
+void drawLabelledObject(int x, int y, const std::string &label, cv::Mat &frame);
+void morphOps(cv::Mat &thresh);
+/// Set detection.yaw and detection.pitch from its centroid.
+void directionToObject(Detection &detection);
+/// Find the filtered object (the largest blob between MIN_OBJECT_AREA and MAX_OBJECT_AREA) in a thresholded frame. Does not touch the globals or draw anything.
+/// offset is the position of threshold inside the full frame when only a window of the frame was thresholded.
+Detection findFilteredObject(const cv::Mat &threshold, cv::Point offset = cv::Point(0,0));
+/// Take over the object position of a detection and draw it on cameraFeed. The flight controller gets the
+/// detection through a FlightOutput (flightOutput.h).
+void reportDetection(const Detection &detection, int &x, int &y, cv::Mat &cameraFeed);
+/// Find the filtered object and draw the result on cameraFeed.
+void trackFilteredObject(int &x, int &y, cv::Mat threshold, cv::Mat &cameraFeed);
+
+#endif
@@ -0,0 +1,20 @@
+/***************************************
+ Lets the tracker build against OpenCV 2.4, 3.x and 4.x.
+
+ The C capture property names (CV_CAP_PROP_*) were part of highgui in 2.4,
+ moved to videoio_c.h in 3.x and to a legacy header in 4.x. Include this
+ instead of opencv.hpp wherever they are used.
+ ************************************/
+
+#ifndef OPENCV_COMPAT_H
+#define OPENCV_COMPAT_H
+
+#include <opencv2/opencv.hpp>
+
+#if CV_MAJOR_VERSION >= 4
+#include <opencv2/videoio/legacy/constants_c.h>
+#elif CV_MAJOR_VERSION == 3
+#include <opencv2/videoio/videoio_c.h>
+#endif
+
+#endif
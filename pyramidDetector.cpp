@@ -0,0 +1,107 @@
+#include "pyramidDetector.h"
+#include "roiTracker.h"
+#include "latencyStats.h"
+
+#include <algorithm>
+
+PyramidDetector::PyramidDetector(int decimation){
+    setDecimation(decimation);
+}
+
+void PyramidDetector::setDecimation(int decimation){
+    factor = std::max(1, std::min(decimation, MAX_DECIMATION));
+}
+
+/// coarseMask = hsvThreshold of the centre pixel of every factor x factor cell of bgr.
+void PyramidDetector::thresholdCoarse(const cv::Mat &bgr, const HSVRange &range){
+    int rows = bgr.rows/factor, cols = bgr.cols/factor;
+    coarseMask.create(rows, cols, CV_8UC1);
+    sampledRow.resize((size_t)cols*3);
+    int offset = factor/2;
+    for (int y = 0; y < rows; y++){
+        const uchar *p = bgr.ptr<uchar>(y*factor + offset) + 3*offset;
+        uchar *q = &sampledRow[0];
+        for (int x = 0; x < cols; x++, p += 3*factor, q += 3){
+            q[0] = p[0]; q[1] = p[1]; q[2] = p[2];
+        }
+        hsvThresholdRow(&sampledRow[0], coarseMask.ptr<uchar>(y), cols, range);
+    }
+}
+
+Detection PyramidDetector::detect(const cv::Mat &bgr, const HSVRange &range, bool useMorphOps, cv::Mat *threshold){
+    CV_Assert(bgr.type() == CV_8UC3);
+    window = cv::Rect();
+    if (factor == 1 || bgr.rows < 8*factor || bgr.cols < 8*factor){
+        cv::Mat &mask = threshold ? *threshold : fineBuffer;
+        hsvThreshold(bgr, range, mask);
+        latencyMark(STAGE_THRESHOLD);
+        if (useMorphOps){
+            morphOps(mask);
+            latencyMark(STAGE_MORPH);
+        }
+        window = cv::Rect(0, 0, bgr.cols, bgr.rows);
+        Detection detection = findFilteredObject(mask);
+        latencyMark(STAGE_BLOB);
+        return detection;
+    }
+
+    // coarse pass. morphOps() erodes 5 px and dilates 29 px wide at full resolution, so the elements shrink by the factor.
+    thresholdCoarse(bgr, range);
+    latencyMark(STAGE_THRESHOLD);
+    if (useMorphOps){
+        int erodeSize = std::max(2, cvRound(5.0/factor));
+        int dilateSize = std::max(2, cvRound(29.0/factor));
+        morphology.erodeDilate(coarseMask, coarseMask, cv::Size(erodeSize, erodeSize), 1, cv::Size(dilateSize, dilateSize), 1);
+        latencyMark(STAGE_MORPH);
+    }
+    const std::vector<Blob> &blobs = extractor.extract(coarseMask);
+    latencyMark(STAGE_BLOB);
+
+    Detection coarse;
+    coarse.numObjects = (int)blobs.size();
+    if (threshold){
+        cv::resize(coarseMask, *threshold, bgr.size(), 0, 0, cv::INTER_NEAREST);
+        latencyMark(STAGE_THRESHOLD);
+    }
+    if (coarse.numObjects >= MAX_NUM_OBJECTS){
+        coarse.tooNoisy = true;
+        return coarse;
+    }
+    // same area limits as findFilteredObject(), in coarse pixels
+    int area2 = factor*factor;
+    int best = -1;
+    for (size_t i = 0; i < blobs.size(); i++){
+        int area = blobs[i].area*area2;
+        if (area>MIN_OBJECT_AREA && area<MAX_OBJECT_AREA && (best < 0 || blobs[i].area>blobs[best].area)){
+            best = (int)i;
+        }
+    }
+    if (best < 0){return coarse;}
+
+    // fine pass over the winning blob's box, padded like a region-of-interest window so the
+    // morphology inside it matches the full frame result
+    cv::Rect box = blobs[best].boundingBox();
+    int padding = factor + ROI_MORPH_PADDING;
+    window = cv::Rect(box.x*factor - padding, box.y*factor - padding, box.width*factor + 2*padding, box.height*factor + 2*padding);
+    window &= cv::Rect(0, 0, bgr.cols, bgr.rows);
+
+    if (fineBuffer.rows < bgr.rows || fineBuffer.cols < bgr.cols){fineBuffer.create(bgr.rows, bgr.cols, CV_8UC1);}
+    cv::Mat fineMask = fineBuffer(cv::Rect(0, 0, window.width, window.height));
+    hsvThreshold(bgr(window), range, fineMask);
+    latencyMark(STAGE_THRESHOLD);
+    if (useMorphOps){
+        morphOps(fineMask);
+        latencyMark(STAGE_MORPH);
+    }
+    Detection detection = findFilteredObject(fineMask, window.tl());
+    latencyMark(STAGE_BLOB);
+    // the frame-wide picture (blob count, noise) comes from the coarse pass
+    detection.numObjects = coarse.numObjects;
+    detection.tooNoisy = false;
+    if (threshold){
+        cv::Mat thresholdWindow = (*threshold)(window);
+        fineMask.copyTo(thresholdWindow);
+        latencyMark(STAGE_THRESHOLD);
+    }
+    return detection;
+}
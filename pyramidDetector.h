@@ -0,0 +1,55 @@
+/***************************************
+ Coarse-to-fine detection of the filtered object.
+
+ The frame is sampled down by an integer decimation factor (every factor-th
+ pixel of every factor-th row) and thresholded, cleaned up and searched for
+ blobs at that size, with the morphology elements and object area limits
+ scaled to match. Only the winning blob's bounding box is then thresholded
+ and searched again at full resolution, which gives the same centroid and
+ area as a full-frame search for any object larger than a few coarse pixels.
+ At factor 2 the coarse stages touch a quarter of the pixels, at factor 4 a
+ sixteenth.
+ ************************************/
+
+#ifndef PYRAMID_DETECTOR_H
+#define PYRAMID_DETECTOR_H
+
+#include <opencv2/opencv.hpp>
+#include <vector>
+#include "binaryMorphology.h"
+#include "blobExtractor.h"
+#include "hsvThreshold.h"
+#include "objectTracking.h"
+
+//largest supported decimation factor
+const int MAX_DECIMATION = 8;
+
+class PyramidDetector {
+public:
+    explicit PyramidDetector(int decimation = 2);
+
+    /// 1 disables the coarse pass, detect() then searches the full frame like findFilteredObject().
+    void setDecimation(int decimation);
+    int decimation() const {return factor;}
+
+    /// Find the filtered object in bgr. The returned detection is in full-frame coordinates.
+    /// threshold, when given, receives a full-size mask: the coarse mask scaled up, with the refined window
+    /// at full resolution. Leave it out when nothing displays the mask, scaling it up is not free.
+    Detection detect(const cv::Mat &bgr, const HSVRange &range, bool useMorphOps, cv::Mat *threshold = 0);
+
+    /// Window refined at full resolution by the last call to detect(), empty if the coarse pass found nothing.
+    cv::Rect lastWindow() const {return window;}
+
+private:
+    void thresholdCoarse(const cv::Mat &bgr, const HSVRange &range);
+
+    int factor;
+    cv::Rect window;
+    std::vector<uchar> sampledRow;
+    cv::Mat coarseMask;
+    cv::Mat fineBuffer;
+    BinaryMorphology morphology;
+    BlobExtractor extractor;
+};
+
+#endif
@@ -0,0 +1,130 @@
+#include "raceTiming.h"
+
+#include <algorithm>
+#include <cstdio>
+
+RaceTiming::RaceTiming(int numCheckpoints, double rearmSeconds, double minLapSeconds)
+: checkpoints(std::max(1, numCheckpoints)), rearm(rearmSeconds), minLap(minLapSeconds) {}
+
+void RaceTiming::setNumCheckpoints(int numCheckpoints){
+    std::lock_guard<std::mutex> guard(lock);
+    checkpoints = std::max(1, numCheckpoints);
+}
+
+void RaceTiming::reset(){
+    std::lock_guard<std::mutex> guard(lock);
+    lastSeen.clear();
+    pilots.clear();
+    eventLog.clear();
+}
+
+bool RaceTiming::observe(int pilot, int checkpoint, bool present, double captureTime){
+    if (!present){return false;}
+    std::lock_guard<std::mutex> guard(lock);
+    std::pair<int,int> key(pilot, checkpoint);
+    std::map<std::pair<int,int>, double>::iterator seen = lastSeen.find(key);
+    bool isCrossing = seen == lastSeen.end() || captureTime - seen->second >= rearm;
+    if (seen == lastSeen.end()){
+        lastSeen[key] = captureTime;
+    }else{
+        seen->second = std::max(seen->second, captureTime);
+    }
+    //a pass the lap logic does not count (too soon for a lap, a split already taken) is no crossing
+    return isCrossing && crossing(pilot, checkpoint, captureTime);
+}
+
+bool RaceTiming::crossing(int pilot, int checkpoint, double time){
+    PilotState &state = pilots[pilot];
+    if (checkpoint == 0){
+        if (!state.started){
+            // first pass of the start/finish line starts this pilot's race
+            state.started = true;
+            state.raceStart = time;
+            state.lapStart = time;
+            state.splits.assign(checkpoints - 1, -1.0);
+        }else if (time - state.lapStart >= minLap){
+            LapRecord lap;
+            lap.lap = (int)state.laps.size() + 1;
+            lap.startTime = state.lapStart;
+            lap.lapTime = time - state.lapStart;
+            lap.splits = state.splits;
+            state.laps.push_back(lap);
+            state.lapStart = time;
+            state.splits.assign(checkpoints - 1, -1.0);
+        }else{
+            return false; // too soon after the last lap, a second look at the same pass
+        }
+    }else if (state.started && checkpoint < checkpoints){
+        if ((int)state.splits.size() < checkpoints - 1){state.splits.resize(checkpoints - 1, -1.0);}
+        double &split = state.splits[checkpoint - 1];
+        if (split >= 0){return false;} // already passed this lap
+        split = time - state.lapStart;
+    }else{
+        return false;
+    }
+    CrossingEvent event;
+    event.pilot = pilot;
+    event.checkpoint = checkpoint;
+    event.time = time;
+    event.lap = state.started ? (int)state.laps.size() + (checkpoint == 0 ? 0 : 1) : 0;
+    eventLog.push_back(event);
+    return true;
+}
+
+std::vector<CrossingEvent> RaceTiming::events() const {
+    std::lock_guard<std::mutex> guard(lock);
+    return eventLog;
+}
+
+std::vector<LapRecord> RaceTiming::laps(int pilot) const {
+    std::lock_guard<std::mutex> guard(lock);
+    std::map<int, PilotState>::const_iterator it = pilots.find(pilot);
+    return it == pilots.end() ? std::vector<LapRecord>() : it->second.laps;
+}
+
+PilotSummary RaceTiming::summarize(int pilot, const PilotState &state) const {
+    PilotSummary summary;
+    summary.pilot = pilot;
+    summary.started = state.started;
+    summary.lapsCompleted = (int)state.laps.size();
+    summary.raceStart = state.raceStart;
+    summary.lastLap = state.laps.empty() ? 0 : state.laps.back().lapTime;
+    summary.bestLap = 0;
+    for (size_t i = 0; i < state.laps.size(); i++){
+        if (i == 0 || state.laps[i].lapTime < summary.bestLap){summary.bestLap = state.laps[i].lapTime;}
+    }
+    summary.raceTime = state.laps.empty() ? 0 : state.lapStart - state.raceStart;
+    summary.currentLapStart = state.lapStart;
+    return summary;
+}
+
+PilotSummary RaceTiming::summary(int pilot) const {
+    std::lock_guard<std::mutex> guard(lock);
+    std::map<int, PilotState>::const_iterator it = pilots.find(pilot);
+    return summarize(pilot, it == pilots.end() ? PilotState() : it->second);
+}
+
+namespace {
+bool aheadOf(const PilotSummary &a, const PilotSummary &b){
+    if (a.lapsCompleted != b.lapsCompleted){return a.lapsCompleted > b.lapsCompleted;}
+    return a.raceStart + a.raceTime < b.raceStart + b.raceTime;
+}
+}
+
+std::vector<PilotSummary> RaceTiming::standings() const {
+    std::lock_guard<std::mutex> guard(lock);
+    std::vector<PilotSummary> table;
+    for (std::map<int, PilotState>::const_iterator it = pilots.begin(); it != pilots.end(); ++it){
+        table.push_back(summarize(it->first, it->second));
+    }
+    std::stable_sort(table.begin(), table.end(), aheadOf);
+    return table;
+}
+
+std::string formatLapTime(double seconds){
+    if (seconds < 0){seconds = 0;}
+    int minutes = (int)(seconds/60);
+    char text[32];
+    snprintf(text, sizeof(text), "%d:%06.3f", minutes, seconds - 60*minutes);
+    return text;
+}
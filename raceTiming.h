@@ -0,0 +1,96 @@
+/***************************************
+ Race, lap and checkpoint timing driven by detection events.
+
+ Detections are fed in as presence samples (pilot, checkpoint, present,
+ capture time). A gate crossing is the first sighting of a pilot at a
+ checkpoint after it has gone unseen for at least the re-arm time, so a
+ detection that flickers for a few frames is counted once. The crossing is
+ stamped with the capture time of that first frame, never with the time the
+ frame finished processing, so timing resolution is one captured frame and
+ processing jitter adds no error.
+
+ Checkpoint 0 is the start/finish line: the first crossing starts a pilot's
+ race, every later one (at least the minimum lap time apart) completes a
+ lap. Checkpoints 1..N-1 record split times within the lap.
+
+ All methods are thread safe.
+ ************************************/
+
+#ifndef RACE_TIMING_H
+#define RACE_TIMING_H
+
+#include <map>
+#include <mutex>
+#include <string>
+#include <utility>
+#include <vector>
+
+struct CrossingEvent {
+    int pilot;
+    int checkpoint;
+    double time;  // capture time of the first frame the pilot was seen at the checkpoint, seconds
+    int lap;      // lap the crossing belongs to, 0 before the race started
+};
+
+struct LapRecord {
+    int lap;                    // 1 based
+    double startTime;           // seconds, same clock as the capture times
+    double lapTime;             // seconds
+    std::vector<double> splits; // time from lap start to checkpoint 1..N-1, negative if it was missed
+};
+
+struct PilotSummary {
+    int pilot;
+    bool started;
+    int lapsCompleted;
+    double raceStart;   // first start/finish crossing
+    double lastLap;     // 0 until a lap is completed
+    double bestLap;     // 0 until a lap is completed
+    double raceTime;    // from race start to the end of the last completed lap
+    double currentLapStart;
+};
+
+class RaceTiming {
+public:
+    RaceTiming(int numCheckpoints = 1, double rearmSeconds = 1.0, double minLapSeconds = 3.0);
+
+    /// Number of checkpoints including the start/finish line. Takes effect from the next lap.
+    void setNumCheckpoints(int numCheckpoints);
+    /// Feed one detection sample, in capture order. Returns true if it produced a crossing event.
+    bool observe(int pilot, int checkpoint, bool present, double captureTime);
+    /// Forget every event and lap.
+    void reset();
+
+    std::vector<CrossingEvent> events() const;
+    std::vector<LapRecord> laps(int pilot) const;
+    PilotSummary summary(int pilot) const;
+    /// Every pilot, most laps first, then earliest finish of the last lap.
+    std::vector<PilotSummary> standings() const;
+
+private:
+    struct PilotState {
+        bool started;
+        double raceStart;
+        double lapStart;
+        std::vector<double> splits;
+        std::vector<LapRecord> laps;
+        PilotState(): started(false), raceStart(0), lapStart(0) {}
+    };
+
+    /// Record a crossing. False if it does not count: too soon for a lap, or a split already taken this lap.
+    bool crossing(int pilot, int checkpoint, double time);
+    PilotSummary summarize(int pilot, const PilotState &state) const;
+
+    mutable std::mutex lock;
+    int checkpoints;
+    double rearm;
+    double minLap;
+    std::map<std::pair<int,int>, double> lastSeen; // (pilot, checkpoint) -> capture time of the last sighting
+    std::map<int, PilotState> pilots;
+    std::vector<CrossingEvent> eventLog;
+};
+
+/// Seconds as "m:ss.sss".
+std::string formatLapTime(double seconds);
+
+#endif
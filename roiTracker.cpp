@@ -0,0 +1,102 @@
+#include "roiTracker.h"
+#include "latencyStats.h"
+
+#include <algorithm>
+#include <cmath>
+
+RoiTracker::RoiTracker(): fullFrameSearch(1) {
+    reset();
+}
+
+void RoiTracker::setDecimation(int decimation){
+    fullFrameSearch.setDecimation(decimation);
+}
+
+void RoiTracker::reset(){
+    haveTrack = false;
+    haveVelocity = false;
+    misses = 0;
+    lastFrame = -1;
+    lastPosition = cv::Point2d(0, 0);
+    velocity = cv::Point2d(0, 0);
+    lastArea = 0;
+    window = cv::Rect();
+}
+
+cv::Rect RoiTracker::predictWindow(long frameIndex, cv::Size frameSize) const {
+    cv::Rect fullFrame(0, 0, frameSize.width, frameSize.height);
+    double elapsed = (double)(frameIndex - lastFrame);
+    if (!haveTrack || elapsed > MAX_ROI_PREDICTION_FRAMES){return fullFrame;}
+
+    // constant velocity prediction from the last two sightings
+    cv::Point2d predicted = lastPosition;
+    if (haveVelocity){
+        predicted.x += velocity.x*elapsed;
+        predicted.y += velocity.y*elapsed;
+    }
+
+    // the window covers the object, the distance it may travel, and doubles with every miss
+    double objectSize = std::sqrt(lastArea);
+    double travel = std::sqrt(velocity.x*velocity.x + velocity.y*velocity.y)*elapsed;
+    double halfSize = std::max((double)MIN_ROI_HALF_SIZE, 2*objectSize + travel) * (1 << misses) + ROI_MORPH_PADDING;
+
+    int x0 = cvFloor(predicted.x - halfSize), y0 = cvFloor(predicted.y - halfSize);
+    int x1 = cvCeil(predicted.x + halfSize), y1 = cvCeil(predicted.y + halfSize);
+    cv::Rect predictedWindow(x0, y0, x1 - x0, y1 - y0);
+    predictedWindow = predictedWindow & fullFrame;
+    return predictedWindow.area() > 0 ? predictedWindow : fullFrame;
+}
+
+void RoiTracker::update(const Detection &detection, long frameIndex){
+    if (detection.found){
+        cv::Point2d position(detection.x, detection.y);
+        if (haveTrack && frameIndex > lastFrame){
+            double elapsed = (double)(frameIndex - lastFrame);
+            velocity = cv::Point2d((position.x - lastPosition.x)/elapsed, (position.y - lastPosition.y)/elapsed);
+            haveVelocity = true;
+        }
+        haveTrack = true;
+        misses = 0;
+        lastFrame = frameIndex;
+        lastPosition = position;
+        lastArea = detection.area;
+    }else if (haveTrack){
+        if (++misses > MAX_ROI_MISSES){reset();}
+    }
+}
+
+Detection RoiTracker::detect(const cv::Mat &bgr, const HSVRange &range, bool useMorphOps, long frameIndex, cv::Mat *threshold){
+    window = predictWindow(frameIndex, bgr.size());
+    Detection detection;
+
+    if (window.width == bgr.cols && window.height == bgr.rows){
+        // lost: full frame search, coarse-to-fine when a decimation factor is set
+        if (haveTrack){reset();}
+        detection = fullFrameSearch.detect(bgr, range, useMorphOps, threshold);
+    }else{
+        // locked: only the window is thresholded, cleaned up and searched. The window changes size from
+        // frame to frame, so its mask is a view into a frame-sized buffer that is only allocated once.
+        if (roiBuffer.rows < bgr.rows || roiBuffer.cols < bgr.cols){roiBuffer.create(bgr.rows, bgr.cols, CV_8UC1);}
+        cv::Mat roiMask = roiBuffer(cv::Rect(0, 0, window.width, window.height));
+        hsvThreshold(bgr(window), range, roiMask);
+        latencyMark(STAGE_THRESHOLD);
+        if (useMorphOps){
+            morphOps(roiMask);
+            latencyMark(STAGE_MORPH);
+        }
+        detection = findFilteredObject(roiMask, window.tl());
+        latencyMark(STAGE_BLOB);
+
+        // only a debug view needs the window placed in a full-size mask
+        if (threshold){
+            threshold->create(bgr.rows, bgr.cols, CV_8UC1);
+            threshold->setTo(cv::Scalar(0));
+            cv::Mat thresholdWindow = (*threshold)(window);
+            roiMask.copyTo(thresholdWindow);
+            latencyMark(STAGE_THRESHOLD);
+        }
+    }
+
+    update(detection, frameIndex);
+    return detection;
+}
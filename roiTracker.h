@@ -0,0 +1,65 @@
+/***************************************
+ Predictive region-of-interest tracking.
+
+ While the object is locked, its next position is predicted from the recent
+ centroids (constant velocity) and threshold, morphology and blob search only
+ run inside a search window around the prediction. Every missed frame doubles
+ the window, and after MAX_ROI_MISSES misses in a row (or when the last
+ sighting is too old to predict from) the tracker falls back to searching the
+ full frame until the object is found again. That search can run
+ coarse-to-fine (see PyramidDetector) to keep the lost frames cheap.
+ ************************************/
+
+#ifndef ROI_TRACKER_H
+#define ROI_TRACKER_H
+
+#include <opencv2/opencv.hpp>
+#include "hsvThreshold.h"
+#include "objectTracking.h"
+#include "pyramidDetector.h"
+
+//misses in a row before the tracker gives up the lock and searches the full frame
+const int MAX_ROI_MISSES = 3;
+//frames without a sighting after which the prediction is considered stale (e.g. after a pause)
+const int MAX_ROI_PREDICTION_FRAMES = 15;
+//smallest half width/height of the search window, in pixels
+const int MIN_ROI_HALF_SIZE = 48;
+//extra border around the window so erode/dilate near its edge match the full frame result
+const int ROI_MORPH_PADDING = 20;
+
+class RoiTracker {
+public:
+    RoiTracker();
+
+    /// Threshold, clean up and search frame frameIndex of bgr, inside the predicted window when locked.
+    /// threshold, when given, receives a full-size mask that is zero outside the searched window. Leave it out
+    /// when nothing displays the mask, clearing a full frame would cost more than searching the window.
+    /// The returned detection is in full-frame coordinates.
+    Detection detect(const cv::Mat &bgr, const HSVRange &range, bool useMorphOps, long frameIndex, cv::Mat *threshold = 0);
+
+    /// Window searched by the last call to detect().
+    cv::Rect lastWindow() const {return window;}
+    /// True while the tracker is searching a window rather than the full frame.
+    bool locked() const {return haveTrack;}
+    /// Forget the track, the next frame is searched in full.
+    void reset();
+    /// Decimation factor of the full-frame search while the object is lost (1 = full resolution).
+    void setDecimation(int decimation);
+
+private:
+    cv::Rect predictWindow(long frameIndex, cv::Size frameSize) const;
+    void update(const Detection &detection, long frameIndex);
+
+    bool haveTrack;
+    bool haveVelocity;
+    int misses;
+    long lastFrame;
+    cv::Point2d lastPosition;
+    cv::Point2d velocity; // pixels per frame
+    double lastArea;
+    cv::Rect window;
+    cv::Mat roiBuffer; // backing store of the window mask
+    PyramidDetector fullFrameSearch;
+};
+
+#endif
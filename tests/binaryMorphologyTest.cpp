@@ -0,0 +1,71 @@
+/***************************************
+ BinaryMorphology against a pixel-by-pixel erode/dilate with cv::erode /
+ cv::dilate semantics: rectangular element, anchor at its center, pixels
+ outside the image ignored. Random 0/255 masks of widths on both sides of
+ the 64-pixel word boundary, several densities and element shapes.
+ ************************************/
+
+#include <algorithm>
+#include <cstdlib>
+#include <vector>
+#include "binaryMorphology.h"
+#include "testCheck.h"
+
+typedef std::vector<uchar> Image;
+
+/// One erode (minimum) or dilate (maximum) pass with a width x height rectangle.
+static Image referencePass(const Image &in, int rows, int cols, int width, int height, bool erode){
+    Image out(in.size());
+    int anchorX = width/2, anchorY = height/2;
+    for (int y = 0; y < rows; y++){
+        for (int x = 0; x < cols; x++){
+            int value = erode ? 255 : 0;
+            for (int j = 0; j < height; j++){
+                for (int i = 0; i < width; i++){
+                    int yy = y + j - anchorY, xx = x + i - anchorX;
+                    if (yy < 0 || yy >= rows || xx < 0 || xx >= cols){continue;}
+                    int p = in[yy*cols + xx];
+                    value = erode ? std::min(value, p) : std::max(value, p);
+                }
+            }
+            out[y*cols + x] = (uchar)value;
+        }
+    }
+    return out;
+}
+
+static Image reference(Image image, int rows, int cols, cv::Size erodeSize, int erodeIterations, cv::Size dilateSize, int dilateIterations){
+    for (int i = 0; i < erodeIterations; i++){image = referencePass(image, rows, cols, erodeSize.width, erodeSize.height, true);}
+    for (int i = 0; i < dilateIterations; i++){image = referencePass(image, rows, cols, dilateSize.width, dilateSize.height, false);}
+    return image;
+}
+
+int main(){
+    srand(1);
+    const int sizes[][2] = {{1, 1}, {1, 70}, {70, 1}, {5, 63}, {9, 64}, {13, 65}, {40, 129}, {100, 200}, {37, 300}};
+    struct Elements {cv::Size erodeSize; int erodeIterations; cv::Size dilateSize; int dilateIterations;};
+    // morphOps()' elements, an asymmetric pair and a single wide pass
+    const Elements elements[] = {{cv::Size(3, 3), 2, cv::Size(8, 8), 4}, {cv::Size(4, 2), 3, cv::Size(5, 7), 2}, {cv::Size(1, 1), 1, cv::Size(29, 3), 1}};
+    BinaryMorphology morphology;
+    for (size_t s = 0; s < sizeof(sizes)/sizeof(sizes[0]); s++){
+        int rows = sizes[s][0], cols = sizes[s][1];
+        for (int density = 5; density < 100; density += 30){
+            Image input(rows*cols);
+            for (size_t i = 0; i < input.size(); i++){input[i] = rand()%100 < density ? 255 : 0;}
+            for (size_t e = 0; e < sizeof(elements)/sizeof(elements[0]); e++){
+                const Elements &el = elements[e];
+                Image expected = reference(input, rows, cols, el.erodeSize, el.erodeIterations, el.dilateSize, el.dilateIterations);
+                cv::Mat mask(rows, cols, CV_8UC1);
+                for (int y = 0; y < rows; y++){std::copy(&input[y*cols], &input[y*cols] + cols, mask.ptr<uchar>(y));}
+                morphology.erodeDilate(mask, mask, el.erodeSize, el.erodeIterations, el.dilateSize, el.dilateIterations);
+                int wrong = 0;
+                for (int y = 0; y < rows; y++){
+                    for (int x = 0; x < cols; x++){wrong += mask.ptr<uchar>(y)[x] != expected[y*cols + x];}
+                }
+                if (wrong){fprintf(stderr, "%dx%d density %d%% elements %d: %d pixels differ\n", rows, cols, density, (int)e, wrong);}
+                CHECK(wrong == 0);
+            }
+        }
+    }
+    return testResult("binaryMorphologyTest");
+}
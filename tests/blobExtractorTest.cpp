@@ -0,0 +1,87 @@
+/***************************************
+ BlobExtractor against a flood fill: random masks of random size and
+ density are labeled both ways with 8-connectivity, and every blob's area,
+ coordinate sums and bounding box must match. Each mask is also labeled in
+ 2 to 4 strips to cover the stitching along strip borders.
+ ************************************/
+
+#include <algorithm>
+#include <cstdlib>
+#include <vector>
+#include "blobExtractor.h"
+#include "testCheck.h"
+
+static bool blobLess(const Blob &a, const Blob &b){
+    if (a.minY != b.minY){return a.minY < b.minY;}
+    if (a.minX != b.minX){return a.minX < b.minX;}
+    if (a.area != b.area){return a.area < b.area;}
+    return a.sumX != b.sumX ? a.sumX < b.sumX : a.sumY < b.sumY;
+}
+
+static bool sameBlob(const Blob &a, const Blob &b){
+    return a.area == b.area && a.sumX == b.sumX && a.sumY == b.sumY &&
+           a.minX == b.minX && a.minY == b.minY && a.maxX == b.maxX && a.maxY == b.maxY;
+}
+
+/// Blobs of mask found with an explicit-stack flood fill.
+static std::vector<Blob> floodFill(const cv::Mat &mask){
+    int rows = mask.rows, cols = mask.cols;
+    std::vector<uchar> seen(rows*cols, 0);
+    std::vector<int> stack;
+    std::vector<Blob> blobs;
+    for (int y = 0; y < rows; y++){
+        for (int x = 0; x < cols; x++){
+            if (!mask.ptr<uchar>(y)[x] || seen[y*cols + x]){continue;}
+            Blob blob = {0, 0, 0, x, y, x, y};
+            seen[y*cols + x] = 1;
+            stack.push_back(y*cols + x);
+            while (!stack.empty()){
+                int p = stack.back();
+                stack.pop_back();
+                int py = p/cols, px = p%cols;
+                blob.area++;
+                blob.sumX += px;
+                blob.sumY += py;
+                blob.minX = std::min(blob.minX, px); blob.maxX = std::max(blob.maxX, px);
+                blob.minY = std::min(blob.minY, py); blob.maxY = std::max(blob.maxY, py);
+                for (int dy = -1; dy <= 1; dy++){
+                    for (int dx = -1; dx <= 1; dx++){
+                        int yy = py + dy, xx = px + dx;
+                        if (yy < 0 || yy >= rows || xx < 0 || xx >= cols){continue;}
+                        if (mask.ptr<uchar>(yy)[xx] && !seen[yy*cols + xx]){
+                            seen[yy*cols + xx] = 1;
+                            stack.push_back(yy*cols + xx);
+                        }
+                    }
+                }
+            }
+            blobs.push_back(blob);
+        }
+    }
+    return blobs;
+}
+
+int main(){
+    srand(3);
+    BlobExtractor extractor;
+    for (int trial = 0; trial < 300; trial++){
+        int rows = 1 + rand()%90, cols = 1 + rand()%150, density = rand()%80;
+        cv::Mat mask(rows, cols, CV_8UC1);
+        for (int y = 0; y < rows; y++){
+            for (int x = 0; x < cols; x++){mask.ptr<uchar>(y)[x] = rand()%100 < density ? 255 : 0;}
+        }
+        std::vector<Blob> expected = floodFill(mask);
+        std::sort(expected.begin(), expected.end(), blobLess);
+        for (int strips = 1; strips <= 4; strips++){
+            std::vector<Blob> found = extractor.extract(mask, strips);
+            std::sort(found.begin(), found.end(), blobLess);
+            bool same = found.size() == expected.size() && std::equal(found.begin(), found.end(), expected.begin(), sameBlob);
+            if (!same){
+                fprintf(stderr, "%dx%d density %d%% in %d strips: %d blobs, flood fill finds %d\n",
+                        rows, cols, density, strips, (int)found.size(), (int)expected.size());
+            }
+            CHECK(same);
+        }
+    }
+    return testResult("blobExtractorTest");
+}
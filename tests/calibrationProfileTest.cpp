@@ -0,0 +1,131 @@
+/***************************************
+ Calibration profiles: what loadCalibrationProfile() reads back equals
+ what saveCalibrationProfile() wrote (object bounds, gate names and
+ bounds, the table byte for byte), with and without gate targets, and no
+ temporary file is left behind. A flipped byte in the table or the header,
+ a truncated file, a wrong magic or version and a missing file are all
+ refused, and a refused load leaves the profile untouched.
+ ************************************/
+
+#include <cstddef>
+#include <cstdio>
+#include <cstring>
+#include <string>
+#include <vector>
+#include "calibrationProfile.h"
+#include "testCheck.h"
+
+static bool sameRange(const HSVRange &a, const HSVRange &b){
+    return a.hMin == b.hMin && a.hMax == b.hMax && a.sMin == b.sMin && a.sMax == b.sMax && a.vMin == b.vMin && a.vMax == b.vMax;
+}
+
+static std::vector<char> readFile(const std::string &file){
+    std::vector<char> bytes;
+    FILE *in = fopen(file.c_str(), "rb");
+    if (!in){return bytes;}
+    char buffer[65536];
+    size_t n;
+    while ((n = fread(buffer, 1, sizeof(buffer), in)) > 0){bytes.insert(bytes.end(), buffer, buffer + n);}
+    fclose(in);
+    return bytes;
+}
+
+static void writeFile(const std::string &file, const std::vector<char> &bytes, size_t size){
+    FILE *out = fopen(file.c_str(), "wb");
+    if (!out){return;}
+    if (size > 0){fwrite(&bytes[0], 1, size, out);}
+    fclose(out);
+}
+
+static bool exists(const std::string &file){
+    FILE *in = fopen(file.c_str(), "rb");
+    if (in){fclose(in);}
+    return in != 0;
+}
+
+/// Load file, which must be refused with an error, and check the profile was left alone.
+static void checkRefused(const std::string &file, const char *what){
+    CalibrationProfile profile;
+    HSVRange untouched = {1, 2, 3, 4, 5, 6};
+    profile.object = untouched;
+    std::string error;
+    bool loaded = loadCalibrationProfile(file, profile, error);
+    if (loaded){fprintf(stderr, "%s was loaded\n", what);}
+    CHECK(!loaded);
+    CHECK(!error.empty());
+    CHECK(sameRange(profile.object, untouched) && !profile.gates);
+}
+
+int main(){
+    const std::string file = "calibrationProfileTest.qrp";
+    const std::string damaged = "calibrationProfileTest-damaged.qrp";
+    HSVRange object = {20, 40, 80, 256, 60, 250};
+
+    // object bounds only
+    CHECK(saveCalibrationProfile(file, object, 0));
+    CHECK(!exists(file + ".tmp"));
+    CalibrationProfile profile;
+    std::string error;
+    CHECK(loadCalibrationProfile(file, profile, error));
+    CHECK(sameRange(profile.object, object));
+    CHECK(!profile.gates);
+
+    // with gates, at the default and a small quantization
+    const int bitCounts[] = {6, 4};
+    for (size_t b = 0; b < sizeof(bitCounts)/sizeof(bitCounts[0]); b++){
+        ColorClassifier gates(bitCounts[b]);
+        HSVRange red = {0, 10, 150, 256, 100, 256}, green = {50, 80, 100, 256, 50, 256}, blue = {100, 130, 120, 256, 40, 256};
+        gates.addTarget("start/finish", red);
+        gates.addTarget("checkpoint 1", green);
+        gates.addTarget(std::string(80, 'x'), blue); // longer than a profile keeps
+        CHECK(saveCalibrationProfile(file, object, &gates));
+        CHECK(!exists(file + ".tmp"));
+        CalibrationProfile loaded;
+        CHECK(loadCalibrationProfile(file, loaded, error));
+        CHECK(sameRange(loaded.object, object));
+        CHECK(loaded.gates && loaded.gates->numTargets() == 3);
+        if (loaded.gates && loaded.gates->numTargets() == 3){
+            CHECK(loaded.gates->quantizationBits() == bitCounts[b]);
+            CHECK(loaded.gates->target(0).name == "start/finish" && sameRange(loaded.gates->target(0).range, red));
+            CHECK(loaded.gates->target(1).name == "checkpoint 1" && sameRange(loaded.gates->target(1).range, green));
+            CHECK(loaded.gates->target(2).name == std::string(PROFILE_NAME_LENGTH - 1, 'x'));
+            CHECK(loaded.gates->table() == gates.table());
+        }
+    }
+
+    std::vector<char> bytes = readFile(file);
+    CHECK(bytes.size() > sizeof(ProfileHeader));
+    if (bytes.size() > sizeof(ProfileHeader)){
+        std::vector<char> copy = bytes;
+        copy[copy.size() - 100] ^= 1; // in the table
+        writeFile(damaged, copy, copy.size());
+        checkRefused(damaged, "a flipped table byte");
+
+        copy = bytes;
+        copy[offsetof(ProfileHeader, object)] ^= 1;
+        writeFile(damaged, copy, copy.size());
+        checkRefused(damaged, "a flipped header byte");
+
+        writeFile(damaged, bytes, bytes.size() - 1);
+        checkRefused(damaged, "a truncated table");
+        writeFile(damaged, bytes, sizeof(ProfileHeader) - 1);
+        checkRefused(damaged, "a truncated header");
+        writeFile(damaged, bytes, 0);
+        checkRefused(damaged, "an empty file");
+
+        copy = bytes;
+        copy[0] = 'X';
+        writeFile(damaged, copy, copy.size());
+        checkRefused(damaged, "a wrong magic");
+
+        copy = bytes;
+        copy[offsetof(ProfileHeader, version)]++;
+        writeFile(damaged, copy, copy.size());
+        checkRefused(damaged, "a wrong version");
+    }
+    remove(damaged.c_str());
+    remove(file.c_str());
+    checkRefused(file, "a missing file");
+
+    return testResult("calibrationProfileTest");
+}
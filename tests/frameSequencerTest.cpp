@@ -0,0 +1,68 @@
+/***************************************
+ FrameSequencer: frames added and skipped in shuffled order come out in
+ frame order, skipped frames and nothing else left out, including when the
+ shuffle reaches further ahead than the ring holds. Frames already handed
+ out, added twice or from before a reset are refused.
+ ************************************/
+
+#include <algorithm>
+#include <cstdlib>
+#include <vector>
+#include "frameSequencer.h"
+#include "testCheck.h"
+
+/// Frames first .. first+count-1, each moved up to maxShift places from its position.
+static std::vector<long> shuffled(long first, int count, int maxShift){
+    std::vector<long> order(count);
+    for (int i = 0; i < count; i++){order[i] = first + i;}
+    for (int i = 0; i < count; i++){
+        int j = std::min(count - 1, i + rand()%(maxShift + 1));
+        std::swap(order[i], order[j]);
+    }
+    return order;
+}
+
+int main(){
+    srand(5);
+    const int shifts[] = {0, 1, 3, 15, 40, 200};
+    for (size_t s = 0; s < sizeof(shifts)/sizeof(shifts[0]); s++){
+        FrameSequencer<long> sequencer(4);
+        const int count = 1000;
+        std::vector<long> order = shuffled(0, count, shifts[s]);
+        std::vector<long> out;
+        long value;
+        for (size_t i = 0; i < order.size(); i++){
+            // every 7th frame was dropped before processing
+            bool added = order[i] % 7 == 3 ? sequencer.skip(order[i]) : sequencer.add(order[i], order[i]);
+            CHECK(added);
+            while (sequencer.next(value)){out.push_back(value);}
+        }
+        std::vector<long> expected;
+        for (long f = 0; f < count; f++){
+            if (f % 7 != 3){expected.push_back(f);}
+        }
+        CHECK(out == expected);
+        CHECK(sequencer.nextFrame() == count);
+        CHECK(sequencer.waiting() == 0);
+    }
+
+    FrameSequencer<int> sequencer;
+    int value = 0;
+    CHECK(sequencer.add(1, 10));
+    CHECK(!sequencer.next(value));   // frame 0 is not in yet
+    CHECK(!sequencer.add(1, 11));    // added twice
+    CHECK(sequencer.add(0, 5));
+    CHECK(sequencer.next(value) && value == 5);
+    CHECK(sequencer.next(value) && value == 10);
+    CHECK(!sequencer.add(0, 6));     // already handed out
+    CHECK(!sequencer.skip(1));
+    CHECK(sequencer.add(3, 30));
+    sequencer.reset(100);
+    CHECK(sequencer.waiting() == 0);
+    CHECK(!sequencer.add(99, 1));
+    CHECK(sequencer.add(100, 7));
+    CHECK(sequencer.next(value) && value == 7);
+    CHECK(sequencer.nextFrame() == 101);
+
+    return testResult("frameSequencerTest");
+}
@@ -0,0 +1,111 @@
+/***************************************
+ RaceTiming: a detection flickering at a gate counts once, laps need the
+ minimum lap time, splits are measured from the lap start and a missed
+ checkpoint leaves a negative split. A whole race fed frame by frame
+ through a FrameSequencer in worker (shuffled) order must give exactly the
+ laps and crossings of the same race fed in capture order.
+ ************************************/
+
+#include <algorithm>
+#include <cmath>
+#include <cstdlib>
+#include <vector>
+#include "frameSequencer.h"
+#include "raceTiming.h"
+#include "testCheck.h"
+
+static bool near(double a, double b){return std::fabs(a - b) < 1e-9;}
+
+/// Gate sightings of one captured frame.
+struct Sample {
+    long frame;
+    double time;
+    bool present[3];
+};
+
+/// A pilot flying 4 laps of 3 gates at 30 fps, seen for a few frames at each gate.
+static std::vector<Sample> race(){
+    const double fps = 30;
+    // seconds into the race at which the pilot passes start/finish, checkpoint 1, checkpoint 2
+    const double passes[][3] = {{0, 2.0, 4.1}, {6.0, 8.2, 10.0}, {12.5, 14.0, 16.6}, {19.0, 21.3, 23.2}, {25.1, -1, -1}};
+    std::vector<Sample> samples;
+    for (long f = 0; f < (long)(27*fps); f++){
+        Sample sample;
+        sample.frame = f;
+        sample.time = 100 + f/fps;
+        for (int g = 0; g < 3; g++){
+            sample.present[g] = false;
+            for (size_t l = 0; l < sizeof(passes)/sizeof(passes[0]); l++){
+                double t = f/fps - passes[l][g];
+                if (passes[l][g] >= 0 && t >= 0 && t < 0.2 && f % 4 != 1){sample.present[g] = true;} // flickers
+            }
+        }
+        samples.push_back(sample);
+    }
+    return samples;
+}
+
+static void observe(RaceTiming &timing, const Sample &sample){
+    for (int g = 0; g < 3; g++){timing.observe(0, g, sample.present[g], sample.time);}
+}
+
+int main(){
+    {
+        RaceTiming timing(3, 1.0, 3.0);
+        CHECK(timing.observe(0, 0, true, 10.0));   // race starts
+        CHECK(!timing.observe(0, 0, true, 10.1));  // same pass
+        CHECK(!timing.observe(0, 0, false, 10.2));
+        CHECK(!timing.observe(0, 0, true, 11.5));  // re-armed, but too soon for a lap
+        CHECK(timing.observe(0, 1, true, 12.0));
+        CHECK(timing.observe(0, 0, true, 15.0));   // lap 1, checkpoint 2 missed
+        CHECK(timing.observe(0, 2, true, 17.5));
+        CHECK(timing.observe(0, 1, true, 18.0));
+        CHECK(timing.observe(0, 0, true, 21.0));   // lap 2
+        std::vector<LapRecord> laps = timing.laps(0);
+        CHECK(laps.size() == 2);
+        if (laps.size() == 2){
+            CHECK(near(laps[0].lapTime, 5.0) && near(laps[0].splits[0], 2.0) && laps[0].splits[1] < 0);
+            CHECK(near(laps[1].lapTime, 6.0) && near(laps[1].splits[0], 3.0) && near(laps[1].splits[1], 2.5));
+        }
+        PilotSummary pilot = timing.summary(0);
+        CHECK(pilot.started && pilot.lapsCompleted == 2 && near(pilot.bestLap, 5.0) && near(pilot.lastLap, 6.0));
+        CHECK(near(pilot.raceTime, 11.0));
+    }
+
+    std::vector<Sample> samples = race();
+    RaceTiming inOrder(3, 1.0, 3.0);
+    for (size_t i = 0; i < samples.size(); i++){observe(inOrder, samples[i]);}
+    std::vector<LapRecord> expected = inOrder.laps(0);
+    CHECK(expected.size() == 4);
+
+    srand(7);
+    for (int run = 0; run < 20; run++){
+        // workers finish frames up to 12 frames out of order, and some frames never reach a worker
+        std::vector<size_t> order(samples.size());
+        for (size_t i = 0; i < order.size(); i++){order[i] = i;}
+        for (size_t i = 0; i < order.size(); i++){std::swap(order[i], order[std::min(order.size() - 1, i + rand()%13)]);}
+        FrameSequencer<Sample> sequencer;
+        RaceTiming timing(3, 1.0, 3.0);
+        Sample next;
+        for (size_t i = 0; i < order.size(); i++){
+            const Sample &sample = samples[order[i]];
+            bool dropped = !sample.present[0] && !sample.present[1] && !sample.present[2] && rand()%5 == 0;
+            if (dropped){
+                sequencer.skip(sample.frame);
+            }else{
+                sequencer.add(sample.frame, sample);
+            }
+            while (sequencer.next(next)){observe(timing, next);}
+        }
+        std::vector<LapRecord> laps = timing.laps(0);
+        bool same = laps.size() == expected.size();
+        for (size_t l = 0; same && l < laps.size(); l++){
+            same = near(laps[l].lapTime, expected[l].lapTime) && near(laps[l].startTime, expected[l].startTime) &&
+                   laps[l].splits.size() == expected[l].splits.size();
+            for (size_t c = 0; same && c < laps[l].splits.size(); c++){same = near(laps[l].splits[c], expected[l].splits[c]);}
+        }
+        CHECK(same);
+        CHECK(timing.events().size() == inOrder.events().size());
+    }
+    return testResult("raceTimingTest");
+}
@@ -0,0 +1,35 @@
+/***************************************
+ Checks shared by the test programs.
+
+ Each test program is one executable that ctest runs. CHECK() prints the
+ failing expression with its file and line and counts it, so one run
+ reports every failure instead of stopping at the first. testResult()
+ turns the count into the exit code ctest looks at.
+ ************************************/
+
+#ifndef TEST_CHECK_H
+#define TEST_CHECK_H
+
+#include <cstdio>
+
+static int testFailures = 0;
+
+#define CHECK(condition) \
+    do { \
+        if (!(condition)){ \
+            testFailures++; \
+            fprintf(stderr, "%s:%d: CHECK(%s) failed\n", __FILE__, __LINE__, #condition); \
+        } \
+    } while (0)
+
+/// Print the summary of the program and return its exit code.
+inline int testResult(const char *name){
+    if (testFailures > 0){
+        fprintf(stderr, "%s: %d checks failed\n", name, testFailures);
+        return 1;
+    }
+    printf("%s: all checks passed\n", name);
+    return 0;
+}
+
+#endif
@@ -0,0 +1,167 @@
+/***************************************
+ TileChangeDetector against the whole-frame path.
+
+ Changes its samples see: on a fixed camera's sequence (static background
+ with sensor noise, a static target-colored patch, a target-colored disc
+ moving across tile borders) every mask must equal hsvThreshold() +
+ morphOps() pixel for pixel, through a threshold change, morphology
+ switched off and on, and a tile size change. Most tiles must be skipped
+ while only the disc moves.
+
+ Changes its samples miss: a dot between the sample rows and a patch that
+ moves less than the change threshold but into the HSV range leave the
+ mask stale. It may only differ around the change, and must match again
+ before refreshFrames() frames have passed.
+ ************************************/
+
+#include <algorithm>
+#include <cstdio>
+#include <vector>
+#include "objectTracking.h"
+#include "testCheck.h"
+#include "tileChangeDetector.h"
+
+const int WIDTH = 640, HEIGHT = 480;
+
+static unsigned noiseState = 1;
+
+/// xorshift, so every run and platform sees the same frames
+static unsigned noise(){
+    noiseState ^= noiseState << 13;
+    noiseState ^= noiseState >> 17;
+    noiseState ^= noiseState << 5;
+    return noiseState;
+}
+
+static void fillOrange(cv::Mat &bgr, int x, int y){
+    uchar *p = bgr.ptr<uchar>(y) + 3*x;
+    p[0] = 0; p[1] = 128; p[2] = 255;
+}
+
+/// Frame n: the background plus up to +-6 of noise per channel, and the disc at its position for n.
+static void render(const cv::Mat &background, int n, cv::Mat &frame){
+    frame.create(HEIGHT, WIDTH, CV_8UC3);
+    for (int y = 0; y < HEIGHT; y++){
+        const uchar *b = background.ptr<uchar>(y);
+        uchar *p = frame.ptr<uchar>(y);
+        for (int x = 0; x < 3*WIDTH; x++){
+            int v = b[x] + (int)(noise()%13) - 6;
+            p[x] = (uchar)(v < 0 ? 0 : v > 255 ? 255 : v);
+        }
+    }
+    int cx = 60 + 3*n, cy = 100 + (n*7)%260, r = 18;
+    for (int y = cy - r; y <= cy + r; y++){
+        for (int x = cx - r; x <= cx + r; x++){
+            if ((x - cx)*(x - cx) + (y - cy)*(y - cy) <= r*r){fillOrange(frame, x, y);}
+        }
+    }
+}
+
+/// Pixels where the masks differ, and the rectangle around them.
+static long differentPixels(const cv::Mat &a, const cv::Mat &b, cv::Rect *where = 0){
+    long count = 0;
+    int x0 = a.cols, y0 = a.rows, x1 = -1, y1 = -1;
+    for (int y = 0; y < a.rows; y++){
+        const uchar *p = a.ptr<uchar>(y), *q = b.ptr<uchar>(y);
+        for (int x = 0; x < a.cols; x++){
+            if (p[x] == q[x]){continue;}
+            count++;
+            x0 = std::min(x0, x); y0 = std::min(y0, y);
+            x1 = std::max(x1, x); y1 = std::max(y1, y);
+        }
+    }
+    if (where){*where = count > 0 ? cv::Rect(x0, y0, x1 - x0 + 1, y1 - y0 + 1) : cv::Rect();}
+    return count;
+}
+
+static void fill(cv::Mat &bgr, cv::Rect area, uchar b, uchar g, uchar r){
+    for (int y = area.y; y < area.y + area.height; y++){
+        uchar *p = bgr.ptr<uchar>(y) + 3*area.x;
+        for (int x = 0; x < area.width; x++, p += 3){p[0] = b; p[1] = g; p[2] = r;}
+    }
+}
+
+/// A noise-free scene gets one change at frame CHANGE_FRAME that the samples do not see, then stays still.
+/// Returns the number of frames the mask was stale.
+static int missedChange(const char *name, cv::Rect area, const uchar before[3], const uchar after[3], bool useMorphOps){
+    const int CHANGE_FRAME = 3;
+    const HSVRange range = {5, 25, 150, 256, 150, 256};
+    cv::Mat frame(240, 320, CV_8UC3), expected, mask;
+    fill(frame, cv::Rect(0, 0, frame.cols, frame.rows), 100, 100, 100);
+    fill(frame, area, before[0], before[1], before[2]);
+    TileChangeDetector detector;
+    int staleFrames = 0, lastStale = -1;
+    for (int n = 0; n < CHANGE_FRAME + 30; n++){
+        if (n == CHANGE_FRAME){fill(frame, area, after[0], after[1], after[2]);}
+        hsvThreshold(frame, range, expected);
+        if (useMorphOps){morphOps(expected);}
+        detector.threshold(frame, range, useMorphOps, mask);
+        cv::Rect where;
+        if (differentPixels(expected, mask, &where) == 0){continue;}
+        staleFrames++;
+        lastStale = n;
+        //only the pixels the change (and morphOps() around it) reaches may be stale
+        cv::Rect reach(area.x - MORPH_MARGIN, area.y - MORPH_MARGIN, area.width + 2*MORPH_MARGIN, area.height + 2*MORPH_MARGIN);
+        CHECK((where & reach) == where);
+    }
+    printf("%s%s: mask stale for %d frames, refreshed within %d\n", name, useMorphOps ? "" : " (no morph)",
+           staleFrames, detector.refreshFrames());
+    CHECK(lastStale < CHANGE_FRAME + detector.refreshFrames());
+    return staleFrames;
+}
+
+int main(){
+    cv::Mat background(HEIGHT, WIDTH, CV_8UC3);
+    for (int y = 0; y < HEIGHT; y++){
+        uchar *p = background.ptr<uchar>(y);
+        for (int x = 0; x < 3*WIDTH; x++){p[x] = (uchar)(90 + (x/3 + y)%60 + noise()%5);}
+    }
+    for (int y = 300; y < 340; y++){
+        for (int x = 500; x < 550; x++){fillOrange(background, x, y);}
+    }
+
+    //every change here is large and bright enough for the samples, so the masks must be exact
+    HSVRange range = {5, 25, 150, 256, 150, 256};
+    TileChangeDetector detector;
+    cv::Mat frame, expected, mask;
+    long wrongFrames = 0;
+    double skipped = 0;
+    int skippedFrames = 0;
+    for (int n = 0; n < 160; n++){
+        if (n == 60){range.hMax = 30;}           // new thresholds: recomputed in full
+        bool useMorphOps = n < 90 || n >= 110;   // morphology off for a while
+        if (n == 130){detector.setTileSize(16);}
+        render(background, n, frame);
+        hsvThreshold(frame, range, expected);
+        if (useMorphOps){morphOps(expected);}
+        detector.threshold(frame, range, useMorphOps, mask);
+        long wrong = differentPixels(expected, mask);
+        if (wrong){
+            fprintf(stderr, "frame %d: %ld pixels differ from the whole-frame mask\n", n, wrong);
+            wrongFrames++;
+        }
+        // the frames right after a full recompute are not counted
+        if (n > 0 && n != 60 && n != 90 && n != 110 && n != 130){
+            skipped += detector.lastFrame().skippedFraction();
+            skippedFrames++;
+        }
+    }
+    CHECK(wrongFrames == 0);
+    double meanSkipped = skippedFrames > 0 ? skipped/skippedFrames : 0;
+    printf("%.1f%% of tiles skipped\n", 100*meanSkipped);
+    CHECK(meanSkipped > 0.7);
+    CHECK(detector.total().frames == 160);
+
+    //both changes are in tile row 2, the last the refresh reaches after the change
+    //a 3x3 dot on rows 1-3 of a sample block: no sample row crosses it. morphOps() would erode it away.
+    const uchar gray[3] = {100, 100, 100}, orange[3] = {0, 128, 255};
+    int stale = missedChange("dot between samples", cv::Rect(141, 65, 3, 3), gray, orange, false);
+    //a patch that brightens by 1+2+3 and so crosses vMin = 150
+    const uchar dim[3] = {45, 96, 149}, bright[3] = {46, 98, 152};
+    stale += missedChange("faint patch", cv::Rect(150, 70, 16, 16), dim, bright, true);
+    stale += missedChange("faint patch", cv::Rect(150, 70, 16, 16), dim, bright, false);
+    //the approximation is real: if this fails the detector became exact, and its header and the read me should say so
+    CHECK(stale > 0);
+
+    return testResult("tileChangeDetectorTest");
+}
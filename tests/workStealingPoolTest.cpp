@@ -0,0 +1,80 @@
+/***************************************
+ WorkStealingPool: every submitted task runs exactly once with 1, 2 and 4
+ workers, with uneven task lengths so workers steal. Tasks a worker submits
+ from inside a task run too. Idle workers block rather than poll, so a
+ task submitted after the pool went idle must still wake one: repeated
+ idle/submit rounds check that no wakeup is lost.
+ ************************************/
+
+#include <atomic>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include "testCheck.h"
+#include "workStealingPool.h"
+
+const long NUM_TASKS = 200000;
+
+static std::vector<std::atomic<int> > runs(NUM_TASKS);
+static std::atomic<long> total(0);
+
+static void countTask(void *, void *item){
+    long i = (long)item;
+    runs[i]++;
+    volatile double x = 0;
+    for (int k = 0; k < (i % 7 == 0 ? 20000 : 200); k++){x = x + k;}
+    total += i;
+}
+
+struct Nested {
+    WorkStealingPool *pool;
+    std::atomic<int> children;
+};
+
+static void childTask(void *context, void *){
+    static_cast<Nested*>(context)->children++;
+}
+
+static void parentTask(void *context, void *){
+    Nested &nested = *static_cast<Nested*>(context);
+    for (int i = 0; i < 4; i++){
+        while (!nested.pool->submit(childTask, &nested, 0)){std::this_thread::yield();}
+    }
+}
+
+int main(){
+    const int threadCounts[] = {1, 2, 4};
+    for (size_t t = 0; t < sizeof(threadCounts)/sizeof(threadCounts[0]); t++){
+        for (long i = 0; i < NUM_TASKS; i++){runs[i] = 0;}
+        total = 0;
+        WorkStealingPool pool(threadCounts[t], 64);
+        for (long i = 0; i < NUM_TASKS; i++){
+            // a full ring refuses the task, the caller retries
+            while (!pool.submit(countTask, 0, (void*)i)){std::this_thread::yield();}
+        }
+        pool.wait();
+        long wrong = 0;
+        for (long i = 0; i < NUM_TASKS; i++){wrong += runs[i] != 1;}
+        CHECK(wrong == 0);
+        CHECK(total == (NUM_TASKS - 1)*NUM_TASKS/2);
+        CHECK(pool.executedTasks() == NUM_TASKS);
+
+        Nested nested;
+        nested.pool = &pool;
+        nested.children = 0;
+        // few enough parents that their children fit in one ring: a single worker cannot make room in its own
+        for (int i = 0; i < 10; i++){CHECK(pool.submit(parentTask, &nested, 0));}
+        pool.wait();
+        CHECK(nested.children == 40);
+
+        // the pool goes idle between rounds, each round's task must wake a worker
+        std::atomic<long> woken(0);
+        for (int round = 0; round < 200; round++){
+            if (round % 50 == 0){std::this_thread::sleep_for(std::chrono::milliseconds(20));}
+            CHECK(pool.submit([](void *context, void *){(*static_cast<std::atomic<long>*>(context))++;}, &woken, 0));
+            pool.wait();
+        }
+        CHECK(woken == 200);
+    }
+    return testResult("workStealingPoolTest");
+}
@@ -0,0 +1,215 @@
+#include "tileChangeDetector.h"
+#include "objectTracking.h"
+
+#include <algorithm>
+#include <cstdlib>
+#include <cstring>
+
+static bool sameRange(const HSVRange &a, const HSVRange &b){
+    return a.hMin == b.hMin && a.hMax == b.hMax && a.sMin == b.sMin && a.sMax == b.sMax && a.vMin == b.vMin && a.vMax == b.vMax;
+}
+
+/// Grow a tile set by radius tiles in every direction.
+static void growTiles(const std::vector<uchar> &in, std::vector<uchar> &out, int tilesX, int tilesY, int radius){
+    out.assign(in.size(), 0);
+    for (int ty = 0; ty < tilesY; ty++){
+        for (int tx = 0; tx < tilesX; tx++){
+            if (!in[ty*tilesX + tx]){continue;}
+            for (int y = std::max(0, ty - radius); y <= std::min(tilesY - 1, ty + radius); y++){
+                for (int x = std::max(0, tx - radius); x <= std::min(tilesX - 1, tx + radius); x++){out[y*tilesX + x] = 1;}
+            }
+        }
+    }
+}
+
+TileChangeDetector::TileChangeDetector(int tileSize, int changeThreshold)
+: tile(std::max(tileSize, CHANGE_SAMPLE_STEP)), pixelThreshold(changeThreshold), tilesX(0), tilesY(0),
+  valid(false), lastMorph(false), frameCount(0) {
+    HSVRange none = {0, 0, 0, 0, 0, 0};
+    lastRange = none;
+}
+
+void TileChangeDetector::reset(){
+    valid = false;
+}
+
+void TileChangeDetector::setTileSize(int size){
+    size = std::max(size, CHANGE_SAMPLE_STEP);
+    if (size == tile){return;}
+    tile = size;
+    frameSize = cv::Size();
+    valid = false;
+}
+
+void TileChangeDetector::allocate(cv::Size size){
+    frameSize = size;
+    tilesX = (size.width + tile - 1)/tile;
+    tilesY = (size.height + tile - 1)/tile;
+    raw.create(size.height, size.width, CV_8UC1);
+    clean.create(size.height, size.width, CV_8UC1);
+    scratch.create(size.height, size.width, CV_8UC1);
+    int samplesX = (size.width + CHANGE_SAMPLE_STEP - 1)/CHANGE_SAMPLE_STEP;
+    int samplesY = (size.height + CHANGE_SAMPLE_STEP - 1)/CHANGE_SAMPLE_STEP;
+    reference.assign((size_t)samplesX*samplesY*3, 0);
+    sampleTileX.resize((size_t)CHANGE_SAMPLE_STEP*samplesX);
+    for (int offset = 0; offset < CHANGE_SAMPLE_STEP; offset++){
+        for (int sx = 0; sx < samplesX; sx++){sampleTileX[offset*samplesX + sx] = (sx*CHANGE_SAMPLE_STEP + offset)/tile;}
+    }
+    changedSamples.assign((size_t)tilesX*tilesY, 0);
+    dirty.assign((size_t)tilesX*tilesY, 0);
+    cleanDirty.assign((size_t)tilesX*tilesY, 0);
+    maskChanged.assign((size_t)tilesX*tilesY, 0);
+    rowMask.resize(size.width);
+}
+
+cv::Rect TileChangeDetector::tileRect(int tx0, int ty0, int tx1, int ty1) const {
+    int x0 = tx0*tile, y0 = ty0*tile;
+    int x1 = std::min(frameSize.width, tx1*tile), y1 = std::min(frameSize.height, ty1*tile);
+    return cv::Rect(x0, y0, x1 - x0, y1 - y0);
+}
+
+void TileChangeDetector::markChanged(const cv::Mat &bgr){
+    std::fill(changedSamples.begin(), changedSamples.end(), 0);
+    const int samplesX = (int)sampleTileX.size()/CHANGE_SAMPLE_STEP;
+    for (int y = 0, sy = 0; y < frameSize.height; y += CHANGE_SAMPLE_STEP, sy++){
+        int offset = sampleOffset(sy);
+        const uchar *p = bgr.ptr<uchar>(y) + 3*offset;
+        const uchar *r = &reference[(size_t)sy*samplesX*3];
+        const int *tileX = &sampleTileX[offset*samplesX];
+        int *counts = &changedSamples[(size_t)(y/tile)*tilesX];
+        int end = (frameSize.width - offset + CHANGE_SAMPLE_STEP - 1)/CHANGE_SAMPLE_STEP;
+        for (int sx = 0; sx < end; sx++, p += 3*CHANGE_SAMPLE_STEP, r += 3){
+            int distance = std::abs(p[0] - r[0]) + std::abs(p[1] - r[1]) + std::abs(p[2] - r[2]);
+            if (distance > pixelThreshold){counts[tileX[sx]]++;}
+        }
+    }
+}
+
+void TileChangeDetector::thresholdTiles(const cv::Mat &bgr, const HSVRange &range){
+    const int samplesX = (int)sampleTileX.size()/CHANGE_SAMPLE_STEP;
+    for (int ty = 0; ty < tilesY; ty++){
+        // one call per pixel row for each run of neighbouring dirty tiles
+        for (int tx0 = 0; tx0 < tilesX; tx0++){
+            if (!dirty[ty*tilesX + tx0]){continue;}
+            int tx1 = tx0 + 1;
+            while (tx1 < tilesX && dirty[ty*tilesX + tx1]){tx1++;}
+            cv::Rect run = tileRect(tx0, ty, tx1, ty + 1);
+            for (int y = run.y; y < run.y + run.height; y++){
+                //only tiles whose mask actually came out different need cleaning up again
+                hsvThresholdRow(bgr.ptr<uchar>(y) + 3*run.x, &rowMask[0], run.width, range);
+                uchar *out = raw.ptr<uchar>(y) + run.x;
+                for (int tx = tx0; tx < tx1; tx++){
+                    int x = (tx - tx0)*tile, width = std::min(tile, run.width - x);
+                    if (memcmp(&rowMask[x], out + x, width) != 0){
+                        memcpy(out + x, &rowMask[x], width);
+                        maskChanged[ty*tilesX + tx] = 1;
+                    }
+                }
+                //the samples on this row become the run's new reference
+                if (y % CHANGE_SAMPLE_STEP == 0){
+                    int offset = sampleOffset(y/CHANGE_SAMPLE_STEP);
+                    const uchar *p = bgr.ptr<uchar>(y) + 3*offset;
+                    uchar *r = &reference[(size_t)(y/CHANGE_SAMPLE_STEP)*samplesX*3];
+                    for (int sx = (run.x - offset + CHANGE_SAMPLE_STEP - 1)/CHANGE_SAMPLE_STEP;
+                         sx*CHANGE_SAMPLE_STEP + offset < run.x + run.width; sx++){
+                        r[3*sx] = p[3*sx*CHANGE_SAMPLE_STEP];
+                        r[3*sx + 1] = p[3*sx*CHANGE_SAMPLE_STEP + 1];
+                        r[3*sx + 2] = p[3*sx*CHANGE_SAMPLE_STEP + 2];
+                    }
+                }
+            }
+            tx0 = tx1;
+        }
+    }
+}
+
+void TileChangeDetector::cleanTiles(){
+    //consecutive tile rows with overlapping dirty spans are cleaned up as one rectangle, so the margin is paid once
+    int ty = 0;
+    while (ty < tilesY){
+        int first = tilesX, last = -1;
+        for (int tx = 0; tx < tilesX; tx++){
+            if (cleanDirty[ty*tilesX + tx]){first = std::min(first, tx); last = tx;}
+        }
+        if (last < 0){ty++; continue;}
+        int ty1 = ty + 1;
+        while (ty1 < tilesY){
+            int nextFirst = tilesX, nextLast = -1;
+            for (int tx = 0; tx < tilesX; tx++){
+                if (cleanDirty[ty1*tilesX + tx]){nextFirst = std::min(nextFirst, tx); nextLast = tx;}
+            }
+            if (nextLast < 0 || nextFirst > last + 1 || nextLast < first - 1){break;}
+            first = std::min(first, nextFirst);
+            last = std::max(last, nextLast);
+            ty1++;
+        }
+        cv::Rect inner = tileRect(first, ty, last + 1, ty1);
+        cv::Rect outer(inner.x - MORPH_MARGIN, inner.y - MORPH_MARGIN, inner.width + 2*MORPH_MARGIN, inner.height + 2*MORPH_MARGIN);
+        outer &= cv::Rect(0, 0, frameSize.width, frameSize.height);
+        //the margin holds real mask, so only pixels closer to the cut than MORPH_MARGIN come out wrong, and those are not kept
+        //regions come in every size, so they are cleaned up in a view of one frame-sized buffer instead of a buffer of their own
+        cv::Mat region = scratch(cv::Rect(0, 0, outer.width, outer.height));
+        raw(outer).copyTo(region);
+        morphOps(region);
+        cv::Mat target = clean(inner);
+        region(cv::Rect(inner.x - outer.x, inner.y - outer.y, inner.width, inner.height)).copyTo(target);
+        frameStats.cleaned += (long)(last + 1 - first)*(ty1 - ty);
+        ty = ty1;
+    }
+}
+
+void TileChangeDetector::threshold(const cv::Mat &bgr, const HSVRange &range, bool useMorphOps, cv::Mat &mask){
+    CV_Assert(bgr.type() == CV_8UC3);
+    if (bgr.cols != frameSize.width || bgr.rows != frameSize.height){
+        allocate(bgr.size());
+        valid = false;
+    }
+    if (!sameRange(range, lastRange) || useMorphOps != lastMorph){valid = false;}
+
+    const int numTiles = tilesX*tilesY;
+    frameStats = TileStats();
+    frameStats.frames = 1;
+    frameStats.tiles = numTiles;
+    if (!valid){
+        std::fill(dirty.begin(), dirty.end(), 1);
+        frameStats.changed = numTiles;
+    }else{
+        markChanged(bgr);
+        std::vector<uchar> &changed = cleanDirty; // reused as scratch until the clean-up set is built
+        for (int t = 0; t < numTiles; t++){
+            changed[t] = changedSamples[t] >= CHANGE_MIN_SAMPLES;
+            frameStats.changed += changed[t];
+        }
+        //an object straddling a tile border may only show in one of the tiles
+        growTiles(changed, dirty, tilesX, tilesY, 1);
+        int refreshRow = (int)(frameCount % tilesY);
+        std::fill(dirty.begin() + refreshRow*tilesX, dirty.begin() + (refreshRow + 1)*tilesX, 1);
+    }
+    for (int t = 0; t < numTiles; t++){frameStats.thresholded += dirty[t];}
+    std::fill(maskChanged.begin(), maskChanged.end(), 0);
+    thresholdTiles(bgr, range);
+
+    cv::Mat &result = useMorphOps ? clean : raw;
+    if (useMorphOps){
+        if (!valid){
+            raw.copyTo(clean);
+            morphOps(clean);
+            frameStats.cleaned = numTiles;
+        }else{
+            //a tile whose mask changed reaches MORPH_MARGIN pixels into the tiles around it
+            growTiles(maskChanged, cleanDirty, tilesX, tilesY, (MORPH_MARGIN + tile - 1)/tile);
+            cleanTiles();
+        }
+    }
+    result.copyTo(mask);
+
+    lastRange = range;
+    lastMorph = useMorphOps;
+    valid = true;
+    frameCount++;
+    totalStats.frames++;
+    totalStats.tiles += frameStats.tiles;
+    totalStats.changed += frameStats.changed;
+    totalStats.thresholded += frameStats.thresholded;
+    totalStats.cleaned += frameStats.cleaned;
+}
@@ -0,0 +1,105 @@
+/***************************************
+ Tile-level change detection for fixed cameras.
+
+ A gate camera sees the same background frame after frame. The frame is
+ split into tiles, and every tile keeps a reference: a sparse grid of BGR
+ samples taken when its mask was last computed. A tile has changed when
+ one of its samples moved further from that reference than sensor noise
+ does. Only changed tiles and their neighbours are thresholded again, and
+ morphOps() only runs again around tiles whose mask came out different.
+ Every other tile keeps the mask it already has, and the result is one
+ whole-frame mask ready for findFilteredObject().
+
+ That mask is an approximation of hsvThreshold() + morphOps(). The sample
+ grid is CHANGE_SAMPLE_STEP pixels apart, so an object of MIN_OBJECT_AREA
+ covers several samples wherever it appears, and each sample row is
+ shifted by one pixel against the previous one, so an edge that creeps by
+ a pixel still crosses samples. But a change that falls between the
+ samples, or moves them less than changeThreshold while still crossing the
+ HSV bounds, is not seen. One tile row is refreshed every frame
+ regardless, so such a tile keeps a stale mask for less than
+ refreshFrames() frames. A new range, morphology setting or frame size
+ recomputes the whole frame.
+
+ Tiles must be processed in frame order, so one detector serves one camera.
+ ************************************/
+
+#ifndef TILE_CHANGE_DETECTOR_H
+#define TILE_CHANGE_DETECTOR_H
+
+#include <opencv2/opencv.hpp>
+#include <vector>
+#include "hsvThreshold.h"
+
+//pixels between change samples, in both directions
+const int CHANGE_SAMPLE_STEP = 4;
+//samples of a tile that must have moved for the tile to count as changed. noise is kept out by the distance threshold.
+const int CHANGE_MIN_SAMPLES = 1;
+//distance from a recomputed region within which morphOps() results depend on it: 2 px of erosion and 16 of dilation
+const int MORPH_MARGIN = 24;
+
+/// Tiles of one frame, or of every frame since the last reset.
+struct TileStats {
+    long frames;
+    long tiles;
+    long changed;     // tiles whose samples moved away from their reference
+    long thresholded; // changed tiles, their neighbours and the refreshed row
+    long cleaned;     // tiles inside the regions morphOps() ran on again, around tiles whose mask changed
+    TileStats(): frames(0), tiles(0), changed(0), thresholded(0), cleaned(0) {}
+    /// Fraction of tiles whose threshold was skipped.
+    double skippedFraction() const {return tiles > 0 ? 1 - (double)thresholded/tiles : 0;}
+};
+
+class TileChangeDetector {
+public:
+    /// changeThreshold is the |dB|+|dG|+|dR| a sample has to move to count as changed.
+    explicit TileChangeDetector(int tileSize = 32, int changeThreshold = 40);
+
+    /// Forget every tile, so the next frame is processed whole.
+    void reset();
+    void setTileSize(int size);
+    int tileSize() const {return tile;}
+    /// Frames in which every tile row is thresholded once by the refresh, however little it changed. 0 before the first frame.
+    int refreshFrames() const {return tilesY;}
+
+    /// Write the mask of the next frame of this camera into mask (CV_8UC1): hsvThreshold(), then morphOps()
+    /// when useMorphOps, recomputed only where the frame was seen to change (see above).
+    void threshold(const cv::Mat &bgr, const HSVRange &range, bool useMorphOps, cv::Mat &mask);
+
+    const TileStats &lastFrame() const {return frameStats;}
+    const TileStats &total() const {return totalStats;}
+    void resetStats() {totalStats = TileStats();}
+
+private:
+    void allocate(cv::Size size);
+    void markChanged(const cv::Mat &bgr);
+    void thresholdTiles(const cv::Mat &bgr, const HSVRange &range);
+    void cleanTiles();
+    cv::Rect tileRect(int tx0, int ty0, int tx1, int ty1) const;
+    /// Column of the first sample on sample row sy. Shifting each row by one catches edges that move less than a step.
+    static int sampleOffset(int sy) {return sy % CHANGE_SAMPLE_STEP;}
+
+    int tile;
+    int pixelThreshold;
+    cv::Size frameSize;
+    int tilesX, tilesY;
+    bool valid;
+    HSVRange lastRange;
+    bool lastMorph;
+    long frameCount;
+
+    cv::Mat raw;      // threshold of every tile, as of the frame each tile was last thresholded
+    cv::Mat clean;    // raw after morphOps()
+    cv::Mat scratch;  // holds the region being cleaned up, with its margin
+    std::vector<uchar> reference;   // BGR of every sample when its tile was last thresholded
+    std::vector<int> sampleTileX;   // tile column of every sample column, for each sampleOffset()
+    std::vector<int> changedSamples; // per tile
+    std::vector<uchar> dirty;       // per tile: thresholded this frame
+    std::vector<uchar> maskChanged; // per tile: thresholded and its mask came out different
+    std::vector<uchar> cleanDirty;  // per tile: mask has to be cleaned up again
+    std::vector<uchar> rowMask;     // one thresholded row, compared with raw before it is stored
+
+    TileStats frameStats, totalStats;
+};
+
+#endif
@@ -0,0 +1,109 @@
+#include "workStealingPool.h"
+
+#include <algorithm>
+
+namespace {
+// ring index of the calling thread when it is a worker of currentPool
+thread_local const WorkStealingPool *currentPool = 0;
+thread_local int currentWorker = -1;
+}
+
+bool WorkStealingPool::TaskRing::push(const Task &task){
+    std::lock_guard<std::mutex> lock(mutex);
+    if (count == tasks.size()){return false;}
+    tasks[(head + count) % tasks.size()] = task;
+    count++;
+    return true;
+}
+
+bool WorkStealingPool::TaskRing::pop(Task &task){
+    std::lock_guard<std::mutex> lock(mutex);
+    if (count == 0){return false;}
+    task = tasks[head];
+    head = (head + 1) % tasks.size();
+    count--;
+    return true;
+}
+
+WorkStealingPool::WorkStealingPool(int threads, int queueCapacity)
+: nextRing(0), queued(0), pending(0), executed(0), stolen(0), stopping(false), sleepers(0) {
+    if (threads <= 0){threads = std::max(1, (int)std::thread::hardware_concurrency());}
+    for (int i = 0; i < threads; i++){
+        rings.push_back(std::unique_ptr<TaskRing>(new TaskRing));
+        rings.back()->tasks.resize(std::max(1, queueCapacity));
+        rings.back()->head = 0;
+        rings.back()->count = 0;
+    }
+    for (int i = 0; i < threads; i++){
+        workers.push_back(std::thread(&WorkStealingPool::workerLoop, this, i));
+    }
+}
+
+WorkStealingPool::~WorkStealingPool(){
+    wait();
+    {
+        std::lock_guard<std::mutex> lock(sleepMutex);
+        stopping = true;
+    }
+    workAvailable.notify_all();
+    for (size_t i = 0; i < workers.size(); i++){workers[i].join();}
+}
+
+bool WorkStealingPool::submit(TaskFunction run, void *context, void *item){
+    Task task = {run, context, item};
+    int index = currentPool == this ? currentWorker : (int)(nextRing++ % rings.size());
+    pending++;
+    if (!rings[index]->push(task)){
+        pending--;
+        return false;
+    }
+    queued++;
+    if (sleepers > 0){
+        std::lock_guard<std::mutex> lock(sleepMutex);
+        workAvailable.notify_one();
+    }
+    return true;
+}
+
+void WorkStealingPool::wait(){
+    std::unique_lock<std::mutex> lock(sleepMutex);
+    allDone.wait(lock, [this]{return pending == 0;});
+}
+
+bool WorkStealingPool::takeTask(int index, Task &task){
+    if (rings[index]->pop(task)){return true;}
+    //steal, starting after our own ring so the thieves spread over the victims
+    int n = (int)rings.size();
+    for (int i = 1; i < n; i++){
+        if (rings[(index + i) % n]->pop(task)){
+            stolen++;
+            return true;
+        }
+    }
+    return false;
+}
+
+void WorkStealingPool::workerLoop(int index){
+    currentPool = this;
+    currentWorker = index;
+    Task task;
+    for (;;){
+        if (queued > 0 && takeTask(index, task)){
+            queued--;
+            task.run(task.context, task.item);
+            executed++;
+            if (--pending == 0){
+                std::lock_guard<std::mutex> lock(sleepMutex);
+                allDone.notify_all();
+            }
+            continue;
+        }
+        std::unique_lock<std::mutex> lock(sleepMutex);
+        if (stopping){return;}
+        sleepers++;
+        //queued and sleepers are sequentially consistent, so submit() sees this sleeper and notifies under
+        //sleepMutex, which it can only take once this worker waits, or the predicate sees the task
+        workAvailable.wait(lock, [this]{return queued > 0 || stopping;});
+        sleepers--;
+    }
+}
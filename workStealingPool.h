@@ -0,0 +1,86 @@
+/***************************************
+ Work-stealing thread pool for per-frame tasks.
+
+ Every worker owns a bounded task ring. Tasks submitted from outside the
+ pool (capture threads) are spread over the rings round robin, tasks
+ submitted by a worker go to its own ring. A worker takes tasks from its
+ own ring and, once that is empty, steals from the others, so a slow frame
+ on one worker never leaves the rest idle while work is queued behind it.
+
+ The rings are not Chase-Lev deques (owner pops newest, thieves take
+ oldest, lock-free): each one is a FIFO behind its own mutex, and owners
+ and thieves both take the oldest task. These are camera frames, and
+ running them in capture order keeps latency low and lets trackers that
+ need frame order skip fewer stale frames. A ring's lock is only contended
+ while it is being stolen from.
+
+ A task is a function pointer and two pointers, so submitting does not
+ allocate. Idle workers block on a condition variable until a task is
+ submitted, they do not poll.
+ ************************************/
+
+#ifndef WORK_STEALING_POOL_H
+#define WORK_STEALING_POOL_H
+
+#include <atomic>
+#include <condition_variable>
+#include <memory>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+class WorkStealingPool {
+public:
+    typedef void (*TaskFunction)(void *context, void *item);
+
+    /// threads 0 = one per core. queueCapacity is per worker.
+    explicit WorkStealingPool(int threads = 0, int queueCapacity = 256);
+    ~WorkStealingPool();
+
+    int numThreads() const {return (int)workers.size();}
+    /// Queue run(context, item). Returns false if the ring it was meant for is full.
+    bool submit(TaskFunction run, void *context, void *item);
+    /// Block until every task submitted so far has finished.
+    void wait();
+
+    /// Tasks run so far, and how many of them were stolen from another worker's ring.
+    long executedTasks() const {return executed;}
+    long stolenTasks() const {return stolen;}
+
+private:
+    WorkStealingPool(const WorkStealingPool &);
+    WorkStealingPool &operator=(const WorkStealingPool &);
+
+    struct Task {
+        TaskFunction run;
+        void *context;
+        void *item;
+    };
+    /// FIFO ring of tasks. The lock is only contended while a worker steals from it.
+    struct TaskRing {
+        std::mutex mutex;
+        std::vector<Task> tasks;
+        size_t head, count;
+        bool push(const Task &task);
+        bool pop(Task &task);
+    };
+
+    void workerLoop(int index);
+    bool takeTask(int index, Task &task);
+
+    std::vector<std::unique_ptr<TaskRing> > rings;
+    std::vector<std::thread> workers;
+    std::atomic<unsigned> nextRing;
+    std::atomic<long> queued;   // tasks sitting in a ring
+    std::atomic<long> pending;  // tasks submitted and not finished
+    std::atomic<long> executed;
+    std::atomic<long> stolen;
+    std::atomic<bool> stopping;
+
+    std::mutex sleepMutex;
+    std::condition_variable workAvailable;
+    std::condition_variable allDone;
+    std::atomic<int> sleepers;
+};
+
+#endif